@@ -3,6 +3,7 @@
 #include "create_actor.h"
 #include "create_network.h"
 #include "random.h"
+#include "utils.h"
 #include <algorithm>
 #include <iostream>
 #include <memory>
@@ -18,7 +19,16 @@ using namespace utils;
 int ThreadSharedData::getAvailableActorIndex()
 {
     std::lock_guard lock(mutex_);
-    return (actor_index_ < static_cast<int>(actors_.size()) ? actor_index_++ : actors_.size());
+    int actor_index = actor_index_;
+    actor_index_ += num_actor_groups_;
+    return (actor_index < static_cast<int>(actors_.size()) ? actor_index : actors_.size());
+}
+
+int ThreadSharedData::getNetworkIndex(int actor_id) const
+{
+    // actors in the same group share networks; each group owns num_networks_per_group_ networks
+    int group_id = actor_id % num_actor_groups_;
+    return group_id * num_networks_per_group_ + (actor_id / num_actor_groups_) % num_networks_per_group_;
 }
 
 void ThreadSharedData::outputGame(const std::shared_ptr<BaseActor>& actor)
@@ -46,7 +56,36 @@ void ThreadSharedData::outputGame(const std::shared_ptr<BaseActor>& actor)
     }
 
     std::lock_guard lock(mutex_);
-    std::cout << oss.str() << std::endl;
+    if (config::zero_actor_num_games_per_frame == 0) {
+        std::cout << oss.str() << std::endl;
+        return;
+    }
+
+    pending_games_ += oss.str() + "\n";
+    if (++num_pending_games_ >= config::zero_actor_num_games_per_frame) { flushGames(); }
+}
+
+void ThreadSharedData::flushGames()
+{
+    // should be called with mutex_ held
+    if (pending_games_.empty()) { return; }
+    std::cout << utils::encodeMessageFrame(pending_games_, config::zero_actor_compress_frame) << std::flush;
+    num_pending_games_ = 0;
+    pending_games_.clear();
+}
+
+void ThreadSharedData::forwardNetwork(int network_id)
+{
+    std::shared_ptr<Network>& network = networks_[network_id];
+    if (network->getNetworkTypeName() == "alphazero") {
+        std::shared_ptr<AlphaZeroNetwork> az_network = std::static_pointer_cast<AlphaZeroNetwork>(network);
+        if (az_network->getBatchSize() > 0) { network_outputs_[network_id] = az_network->forward(); }
+    } else if (network->getNetworkTypeName() == "muzero" || network->getNetworkTypeName() == "muzero_atari") {
+        std::shared_ptr<MuZeroNetwork> muzero_network = std::static_pointer_cast<MuZeroNetwork>(network);
+        // actors sharing the network may queue initial and recurrent rows in the same round, so both are forwarded and kept apart
+        if (muzero_network->getInitialInputBatchSize() > 0) { network_outputs_[network_id] = muzero_network->initialInference(); }
+        if (muzero_network->getRecurrentInputBatchSize() > 0) { recurrent_network_outputs_[network_id] = muzero_network->recurrentInference(); }
+    }
 }
 
 std::pair<int, int> ThreadSharedData::calculateTrainingDataRange(const std::shared_ptr<BaseActor>& actor)
@@ -71,7 +110,11 @@ void SlaveThread::initialize()
 
 void SlaveThread::runJob()
 {
-    if (getSharedData()->do_cpu_job_) {
+    if (config::zero_actor_pipelined_evaluation) {
+        // evaluate the batch of the other actor group while the current group is expanded
+        doGPUJob();
+        while (doCPUJob()) {}
+    } else if (getSharedData()->do_cpu_job_) {
         while (doCPUJob()) {}
     } else {
         doGPUJob();
@@ -84,33 +127,26 @@ bool SlaveThread::doCPUJob()
     if (actor_id >= getSharedData()->actors_.size()) { return false; }
 
     std::shared_ptr<BaseActor>& actor = getSharedData()->actors_[actor_id];
-    int network_id = actor_id % getSharedData()->networks_.size();
-    int network_output_id = actor->getNNEvaluationBatchIndex();
-    if (network_output_id >= 0) {
-        assert(network_output_id < static_cast<int>(getSharedData()->network_outputs_[network_id].size()));
-        actor->afterNNEvaluation(getSharedData()->network_outputs_[network_id][network_output_id]);
+    int network_id = getSharedData()->getNetworkIndex(actor_id);
+    if (actor->getNNEvaluationBatchIndex() >= 0) {
+        actor->afterNNEvaluation(actor->isRecurrentInference() ? getSharedData()->recurrent_network_outputs_[network_id] : getSharedData()->network_outputs_[network_id]);
         if (actor->isSearchDone()) { handleSearchDone(actor_id); }
     }
     actor->beforeNNEvaluation();
+    while (actor->getNNEvaluationBatchIndex() < 0 && actor->isSearchDone()) {
+        // the search can be finished without any network evaluation if all leaves hit the transposition table
+        handleSearchDone(actor_id);
+        actor->beforeNNEvaluation();
+    }
     return true;
 }
 
 void SlaveThread::doGPUJob()
 {
-    if (id_ >= static_cast<int>(getSharedData()->networks_.size())) { return; }
+    if (id_ >= getSharedData()->num_networks_per_group_) { return; }
 
-    std::shared_ptr<Network>& network = getSharedData()->networks_[id_];
-    if (network->getNetworkTypeName() == "alphazero") {
-        std::shared_ptr<AlphaZeroNetwork> az_network = std::static_pointer_cast<AlphaZeroNetwork>(network);
-        if (az_network->getBatchSize() > 0) { getSharedData()->network_outputs_[id_] = az_network->forward(); }
-    } else if (network->getNetworkTypeName() == "muzero" || network->getNetworkTypeName() == "muzero_atari") {
-        std::shared_ptr<MuZeroNetwork> muzero_network = std::static_pointer_cast<MuZeroNetwork>(network);
-        if (muzero_network->getInitialInputBatchSize() > 0) {
-            getSharedData()->network_outputs_[id_] = std::static_pointer_cast<MuZeroNetwork>(network)->initialInference();
-        } else if (muzero_network->getRecurrentInputBatchSize() > 0) {
-            getSharedData()->network_outputs_[id_] = std::static_pointer_cast<MuZeroNetwork>(network)->recurrentInference();
-        }
-    }
+    int network_id = ((getSharedData()->actor_group_id_ + 1) % getSharedData()->num_actor_groups_) * getSharedData()->num_networks_per_group_ + id_;
+    getSharedData()->forwardNetwork(network_id);
 }
 
 void SlaveThread::handleSearchDone(int actor_id)
@@ -140,10 +176,14 @@ void ActorGroup::run()
         handleCommand();
 
         if (!running_) { continue; }
-        getSharedData()->actor_index_ = 0;
+        getSharedData()->actor_index_ = getSharedData()->actor_group_id_;
         for (auto& t : slave_threads_) { t->start(); }
         for (auto& t : slave_threads_) { t->finish(); }
-        getSharedData()->do_cpu_job_ = !getSharedData()->do_cpu_job_;
+        if (config::zero_actor_pipelined_evaluation) {
+            getSharedData()->actor_group_id_ = (getSharedData()->actor_group_id_ + 1) % getSharedData()->num_actor_groups_;
+        } else {
+            getSharedData()->do_cpu_job_ = !getSharedData()->do_cpu_job_;
+        }
     }
 }
 
@@ -151,10 +191,13 @@ void ActorGroup::initialize()
 {
     int num_threads = std::max(static_cast<int>(torch::cuda::device_count()), config::zero_num_threads);
     createSlaveThreads(num_threads);
+    getSharedData()->actor_group_id_ = 0;
+    getSharedData()->num_actor_groups_ = (config::zero_actor_pipelined_evaluation ? 2 : 1);
     createNeuralNetworks();
     createActors();
     running_ = false;
     getSharedData()->do_cpu_job_ = true;
+    getSharedData()->num_pending_games_ = 0;
 
     // create one thread to handle I/O
     commands_.clear();
@@ -167,12 +210,24 @@ void ActorGroup::initialize()
 
 void ActorGroup::createNeuralNetworks()
 {
-    int num_networks = std::min(static_cast<int>(torch::cuda::device_count()), config::zero_num_parallel_games);
+    // each actor group owns one network per GPU so that one group can push data while the other group is being evaluated
+    int num_actor_groups = getSharedData()->num_actor_groups_;
+    int num_networks = std::min(static_cast<int>(torch::cuda::device_count()), config::zero_num_parallel_games / num_actor_groups);
     assert(num_networks > 0);
-    getSharedData()->networks_.resize(num_networks);
-    getSharedData()->network_outputs_.resize(num_networks);
-    for (int gpu_id = 0; gpu_id < num_networks; ++gpu_id) {
-        getSharedData()->networks_[gpu_id] = createNetwork(config::nn_file_name, gpu_id);
+    getSharedData()->num_networks_per_group_ = num_networks;
+    getSharedData()->networks_.resize(num_networks * num_actor_groups);
+    getSharedData()->network_outputs_.resize(num_networks * num_actor_groups);
+    getSharedData()->recurrent_network_outputs_.resize(num_networks * num_actor_groups);
+    // the evaluation cache is only attached when enabled, so that actors skip it entirely by default
+    getSharedData()->evaluation_cache_ = (config::zero_actor_evaluation_cache_size > 0 ? std::make_shared<AlphaZeroEvaluationCache>(config::zero_actor_evaluation_cache_size) : nullptr);
+    // each network evaluates the leaves of its actors (see getNetworkIndex()) once per round
+    int num_actors_per_network = ((config::zero_num_parallel_games + num_actor_groups - 1) / num_actor_groups + num_networks - 1) / num_networks;
+    int reserved_batch_size = num_actors_per_network * std::max(config::actor_mcts_selfplay_batch_size, 1);
+    for (int network_id = 0; network_id < num_networks * num_actor_groups; ++network_id) {
+        getSharedData()->networks_[network_id] = createNetwork(config::nn_file_name, network_id % num_networks, reserved_batch_size);
+        if (getSharedData()->evaluation_cache_ && getSharedData()->networks_[network_id]->getNetworkTypeName() == "alphazero") {
+            std::static_pointer_cast<AlphaZeroNetwork>(getSharedData()->networks_[network_id])->setEvaluationCache(getSharedData()->evaluation_cache_);
+        }
     }
 }
 
@@ -182,7 +237,7 @@ void ActorGroup::createActors()
     std::shared_ptr<Network>& network = getSharedData()->networks_[0];
     uint64_t tree_node_size = static_cast<uint64_t>(config::actor_num_simulation + 1) * network->getActionSize();
     for (int i = 0; i < config::zero_num_parallel_games; ++i) {
-        getSharedData()->actors_.emplace_back(createActor(tree_node_size, getSharedData()->networks_[i % getSharedData()->networks_.size()]));
+        getSharedData()->actors_.emplace_back(createActor(tree_node_size, getSharedData()->networks_[getSharedData()->getNetworkIndex(i)]));
     }
 }
 
@@ -229,7 +284,11 @@ void ActorGroup::handleCommand(const std::string& command_prefix, const std::str
         std::vector<std::string> args = utils::stringToVector(command);
         assert(args.size() == 2);
         config::nn_file_name = args[1];
+        // with pipelined evaluation, the group just expanded still has reserved rows, so evaluate them by the old model before reloading
+        for (size_t network_id = 0; network_id < getSharedData()->networks_.size(); ++network_id) { getSharedData()->forwardNetwork(network_id); }
         for (auto& network : getSharedData()->networks_) { network->loadModel(config::nn_file_name, network->getGPUID()); }
+        for (size_t actor_id = 0; actor_id < getSharedData()->actors_.size(); ++actor_id) { getSharedData()->actors_[actor_id]->setNetwork(getSharedData()->networks_[getSharedData()->getNetworkIndex(actor_id)]); }
+        if (getSharedData()->evaluation_cache_) { getSharedData()->evaluation_cache_->clear(); }
     } else if (command_prefix == "update_config") {
         std::cerr << "[command] " << command << std::endl;
         assert(command.find(" ") != std::string::npos);
@@ -245,8 +304,10 @@ void ActorGroup::handleCommand(const std::string& command_prefix, const std::str
     } else if (command_prefix == "stop") {
         std::cerr << "[command] " << command << std::endl;
         running_ = false;
+        getSharedData()->flushGames();
     } else if (command_prefix == "quit") {
         std::cerr << "[command] " << command << std::endl;
+        getSharedData()->flushGames();
         exit(0);
     }
 }
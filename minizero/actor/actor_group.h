@@ -1,5 +1,6 @@
 #pragma once
 
+#include "alphazero_network.h"
 #include "base_actor.h"
 #include "network.h"
 #include "paralleler.h"
@@ -16,15 +17,25 @@ namespace minizero::actor {
 class ThreadSharedData : public utils::BaseSharedData {
 public:
     int getAvailableActorIndex();
+    int getNetworkIndex(int actor_id) const;
     void outputGame(const std::shared_ptr<BaseActor>& actor);
+    void flushGames();
+    void forwardNetwork(int network_id);
     std::pair<int, int> calculateTrainingDataRange(const std::shared_ptr<BaseActor>& actor);
 
     bool do_cpu_job_;
     int actor_index_;
+    int actor_group_id_;
+    int num_actor_groups_;
+    int num_networks_per_group_;
+    int num_pending_games_;
+    std::string pending_games_;
     std::mutex mutex_;
     std::vector<std::shared_ptr<BaseActor>> actors_;
     std::vector<std::shared_ptr<network::Network>> networks_;
-    std::vector<std::vector<std::shared_ptr<network::NetworkOutput>>> network_outputs_;
+    std::vector<std::shared_ptr<network::NetworkOutputBatch>> network_outputs_; // alphazero or muzero initial inference
+    std::vector<std::shared_ptr<network::NetworkOutputBatch>> recurrent_network_outputs_;
+    std::shared_ptr<network::AlphaZeroEvaluationCache> evaluation_cache_;
 };
 
 class SlaveThread : public utils::BaseSlaveThread {
@@ -34,8 +34,9 @@ public:
 
     virtual Action think(bool with_play = false, bool display_board = false) = 0;
     virtual void beforeNNEvaluation() = 0;
-    virtual void afterNNEvaluation(const std::shared_ptr<network::NetworkOutput>& network_output) = 0;
+    virtual void afterNNEvaluation(const std::shared_ptr<network::NetworkOutputBatch>& network_output_batch) = 0;
     virtual bool isSearchDone() const = 0;
+    virtual bool isRecurrentInference() const = 0;
     virtual Action getSearchAction() const = 0;
     virtual bool isResign() const = 0;
     virtual std::string getSearchInfo() const = 0;
@@ -1,11 +1,35 @@
 #include "mcts.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
 
 namespace minizero::actor {
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// compiled for AVX2 regardless of the build flags, and only called after checking that the CPU supports it
+__attribute__((target("avx2"))) static int calculatePUCTScoresAVX2(int size, float puct_factor, float init_q_value, const float* policies, const float* counts, const float* values, float* scores)
+{
+    const __m256 factor = _mm256_set1_ps(puct_factor);
+    const __m256 init_q = _mm256_set1_ps(init_q_value);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= size; i += 8) {
+        __m256 count = _mm256_loadu_ps(counts + i);
+        __m256 value_u = _mm256_div_ps(_mm256_mul_ps(factor, _mm256_loadu_ps(policies + i)), _mm256_add_ps(one, count));
+        __m256 value_q = _mm256_blendv_ps(_mm256_loadu_ps(values + i), init_q, _mm256_cmp_ps(count, zero, _CMP_EQ_OQ));
+        _mm256_storeu_ps(scores + i, _mm256_add_ps(value_u, value_q));
+    }
+    return i;
+}
+#endif
+
 void MCTSNode::reset()
 {
     num_children_ = 0;
     hidden_state_data_index_ = -1;
+    unexpanded_children_data_index_ = -1;
+    solver_status_ = SolverStatus::kUnsolved;
     mean_ = 0.0f;
     count_ = 0.0f;
     virtual_loss_ = 0.0f;
@@ -77,7 +101,9 @@ std::string MCTSNode::toString() const
 void MCTS::reset()
 {
     Tree::reset();
+    num_reused_simulation_ = 0;
     tree_hidden_state_data_.reset();
+    tree_unexpanded_children_data_.reset();
     tree_value_bound_.clear();
 }
 
@@ -123,6 +149,22 @@ MCTSNode* MCTS::selectChildBySoftmaxCount(const MCTSNode* node, float temperatur
     return selected;
 }
 
+MCTSNode* MCTS::selectChildBySolverStatus(const MCTSNode* node) const
+{
+    // play the most visited winning child, and avoid a losing child even if it is the most visited; returns nullptr to leave the decision to the counts
+    assert(node && !node->isLeaf());
+    MCTSNode* winning_child = nullptr;
+    MCTSNode* non_losing_child = nullptr;
+    for (int i = 0; i < node->getNumChildren(); ++i) {
+        MCTSNode* child = node->getChild(i);
+        if (child->getSolverStatus() == SolverStatus::kWin && (!winning_child || child->getCount() > winning_child->getCount())) { winning_child = child; }
+        if (child->getSolverStatus() != SolverStatus::kLoss && (!non_losing_child || child->getCount() > non_losing_child->getCount())) { non_losing_child = child; }
+    }
+    if (winning_child) { return winning_child; }
+    if (non_losing_child && selectChildByMaxCount(node)->getSolverStatus() == SolverStatus::kLoss) { return non_losing_child; }
+    return nullptr;
+}
+
 std::string MCTS::getSearchDistributionString() const
 {
     const MCTSNode* root = getRootNode();
@@ -141,8 +183,9 @@ std::vector<MCTSNode*> MCTS::selectFromNode(MCTSNode* start_node)
     assert(start_node);
     MCTSNode* node = start_node;
     std::vector<MCTSNode*> node_path{node};
-    while (!node->isLeaf()) {
-        node = selectChildByPUCTScore(node);
+    while (!node->isLeaf() && !node->isSolved()) {
+        MCTSNode* child = selectChildByPUCTScore(node);
+        node = (child ? child : expandMoreChildren(node, getNumChildrenToWiden(node)));
         node_path.push_back(node);
     }
     return node_path;
@@ -151,16 +194,25 @@ std::vector<MCTSNode*> MCTS::selectFromNode(MCTSNode* start_node)
 void MCTS::expand(MCTSNode* leaf_node, const std::vector<ActionCandidate>& action_candidates)
 {
     assert(leaf_node && action_candidates.size() > 0);
-    leaf_node->setFirstChild(allocateNodes(action_candidates.size()));
-    leaf_node->setNumChildren(action_candidates.size());
-    for (size_t i = 0; i < action_candidates.size(); ++i) {
-        const auto& candidate = action_candidates[i];
-        MCTSNode* child = leaf_node->getChild(i);
-        child->reset();
-        child->setAction(candidate.action_);
-        child->setPolicy(candidate.policy_);
-        child->setPolicyLogit(candidate.policy_logit_);
+    int num_children = action_candidates.size();
+    if (config::actor_mcts_num_expanded_children > 0 && num_children > config::actor_mcts_num_expanded_children && leaf_node != getRootNode()) {
+        // only the children with the highest policy are expanded, the others are kept sorted by policy and expanded when selected (action_candidates are sorted by policy)
+        num_children = config::actor_mcts_num_expanded_children;
+        leaf_node->setUnexpandedChildrenDataIndex(tree_unexpanded_children_data_.store(action_candidates));
     }
+    leaf_node->setFirstChild(allocateNodes(num_children));
+    leaf_node->setNumChildren(num_children);
+    setChildren(leaf_node->getChild(0), action_candidates.data(), num_children);
+}
+
+bool MCTS::expandAllChildren(MCTSNode* node)
+{
+    assert(node && !node->isLeaf());
+    if (node->getUnexpandedChildrenDataIndex() == -1) { return true; }
+    int num_children = tree_unexpanded_children_data_.getData(node->getUnexpandedChildrenDataIndex()).size();
+    if (current_node_size_ + num_children > 1 + tree_node_size_) { return false; }
+    expandMoreChildren(node, num_children);
+    return true;
 }
 
 void MCTS::backup(const std::vector<MCTSNode*>& node_path, const float value, const float reward /* = 0.0f */)
@@ -178,41 +230,237 @@ void MCTS::backup(const std::vector<MCTSNode*>& node_path, const float value, co
     }
 }
 
+void MCTS::reuseSubtree(MCTSNode* new_root)
+{
+    assert(new_root && new_root != getRootNode() && !new_root->isLeaf());
+
+    // collect children blocks of the subtree, sorted by their position in the node array
+    std::vector<std::pair<MCTSNode*, int>> blocks;
+    std::vector<MCTSNode*> stack{new_root};
+    while (!stack.empty()) {
+        MCTSNode* node = stack.back();
+        stack.pop_back();
+        if (node->isLeaf()) { continue; }
+        blocks.push_back({node->getChild(0), node->getNumChildren()});
+        for (int i = 0; i < node->getNumChildren(); ++i) { stack.push_back(node->getChild(i)); }
+    }
+    std::vector<std::pair<std::pair<size_t, uint64_t>, std::pair<MCTSNode*, int>>> ordered_blocks; // (allocation order, block)
+    for (const auto& block : blocks) { ordered_blocks.push_back({getNodeOrder(block.first), block}); }
+    std::sort(ordered_blocks.begin(), ordered_blocks.end());
+
+    // compact the subtree to the front of the node chunks in allocation order; each block only moves forward, so earlier moves never overwrite live nodes
+    *getRootNode() = *new_root;
+    current_node_size_ = 1;
+    current_chunk_ = 0;
+    current_chunk_offset_ = 1;
+    std::vector<std::pair<MCTSNode*, MCTSNode*>> relocated_blocks; // (old first child, new first child)
+    for (const auto& ordered_block : ordered_blocks) {
+        const std::pair<MCTSNode*, int>& block = ordered_block.second;
+        MCTSNode* first_child = allocateNodes(block.second);
+        assert(getNodeOrder(first_child) <= getNodeOrder(block.first));
+        for (int i = 0; i < block.second; ++i) { first_child[i] = block.first[i]; }
+        relocated_blocks.push_back({block.first, first_child});
+    }
+    std::sort(relocated_blocks.begin(), relocated_blocks.end());
+
+    // relink children, and rebuild hidden states and value bounds of the remaining nodes
+    TreeHiddenStateData hidden_state_data;
+    TreeData<std::vector<ActionCandidate>> unexpanded_children_data;
+    tree_value_bound_.clear();
+    stack.push_back(getRootNode());
+    while (!stack.empty()) {
+        MCTSNode* node = stack.back();
+        stack.pop_back();
+        if (node->getHiddenStateDataIndex() != -1) { node->setHiddenStateDataIndex(hidden_state_data.store(tree_hidden_state_data_.getData(node->getHiddenStateDataIndex()))); }
+        if (node->getUnexpandedChildrenDataIndex() != -1) { node->setUnexpandedChildrenDataIndex(unexpanded_children_data.store(tree_unexpanded_children_data_.getData(node->getUnexpandedChildrenDataIndex()))); }
+        if (config::actor_mcts_value_rescale && node->getCount() > 0) { ++tree_value_bound_[node->getReward() + config::actor_mcts_reward_discount * node->getMean()]; }
+        if (node->isLeaf()) { continue; }
+
+        auto it = std::lower_bound(relocated_blocks.begin(), relocated_blocks.end(), std::make_pair(node->getChild(0), static_cast<MCTSNode*>(nullptr)));
+        assert(it != relocated_blocks.end() && it->first == node->getChild(0));
+        node->setFirstChild(it->second);
+        for (int i = 0; i < node->getNumChildren(); ++i) { stack.push_back(node->getChild(i)); }
+    }
+    tree_hidden_state_data_ = hidden_state_data;
+    tree_unexpanded_children_data_ = unexpanded_children_data;
+    num_reused_simulation_ = getRootNode()->getCount();
+}
+
+void MCTS::solveLeaf(MCTSNode* leaf_node, float value)
+{
+    // flip the value to the player who made the action, the same as getNormalizedMean()
+    value = (leaf_node->getAction().getPlayer() == env::charToPlayer(config::actor_mcts_value_flipping_player) ? -value : value);
+    leaf_node->setSolverStatus(value > 0 ? SolverStatus::kWin : (value < 0 ? SolverStatus::kLoss : SolverStatus::kDraw));
+}
+
+void MCTS::propagateSolverStatus(const std::vector<MCTSNode*>& node_path)
+{
+    // the selection stops at solved nodes, so only the leaf can be solved; stop at the first ancestor that is not proven
+    for (int i = static_cast<int>(node_path.size()) - 2; i >= 0; --i) {
+        SolverStatus solver_status = calculateSolverStatus(node_path[i]);
+        if (solver_status == SolverStatus::kUnsolved) { break; }
+        node_path[i]->setSolverStatus(solver_status);
+    }
+}
+
+float MCTS::getSolvedValue(const MCTSNode* node) const
+{
+    assert(node && node->isSolved());
+    float value = (node->getSolverStatus() == SolverStatus::kWin ? 1.0f : (node->getSolverStatus() == SolverStatus::kLoss ? -1.0f : 0.0f));
+    return (node->getAction().getPlayer() == env::charToPlayer(config::actor_mcts_value_flipping_player) ? -value : value);
+}
+
+SolverStatus MCTS::calculateSolverStatus(const MCTSNode* node) const
+{
+    // the children are solved for the player to move: a winning child proves a win, otherwise all children must be solved
+    assert(node && !node->isLeaf());
+    bool has_draw = false;
+    bool has_win = false;
+    bool is_all_solved = (node->getUnexpandedChildrenDataIndex() == -1);
+    for (int i = 0; i < node->getNumChildren() && !has_win; ++i) {
+        SolverStatus child_status = node->getChild(i)->getSolverStatus();
+        has_win = (child_status == SolverStatus::kWin);
+        has_draw |= (child_status == SolverStatus::kDraw);
+        is_all_solved &= (child_status != SolverStatus::kUnsolved);
+    }
+    if (!has_win && !is_all_solved) { return SolverStatus::kUnsolved; }
+
+    SolverStatus solver_status = (has_win ? SolverStatus::kWin : (has_draw ? SolverStatus::kDraw : SolverStatus::kLoss));
+    if (solver_status == SolverStatus::kDraw || node->getChild(0)->getAction().getPlayer() == node->getAction().getPlayer()) { return solver_status; }
+    return (solver_status == SolverStatus::kWin ? SolverStatus::kLoss : SolverStatus::kWin);
+}
+
 MCTSNode* MCTS::selectChildByPUCTScore(const MCTSNode* node) const
 {
     assert(node && !node->isLeaf());
-    MCTSNode* selected = nullptr;
+    const int num_children = node->getNumChildren();
+    MCTSNode* children = node->getChild(0);
+
+    // same as getNormalizedMean(), but the parts shared by all children are computed once
+    const bool value_rescale = config::actor_mcts_value_rescale;
+    const bool has_value_bound = (tree_value_bound_.size() >= 2);
+    const float value_lower_bound = (has_value_bound ? tree_value_bound_.begin()->first : 0.0f);
+    const float value_range = (has_value_bound ? tree_value_bound_.rbegin()->first - value_lower_bound : 1.0f);
+    const env::Player flipping_player = env::charToPlayer(config::actor_mcts_value_flipping_player);
+    const float discount = config::actor_mcts_reward_discount;
+
+    // gather the statistics of the children into contiguous arrays in one pass
+    thread_local std::vector<float> policies, counts, values, scores;
+    policies.resize(num_children);
+    counts.resize(num_children);
+    values.resize(num_children);
+    scores.resize(num_children);
+    float sum_of_values = 0.0f;
+    int num_visited_children = 0;
+    bool has_virtual_loss = false;
+    for (int i = 0; i < num_children; ++i) {
+        const MCTSNode& child = children[i];
+        policies[i] = child.getPolicy();
+        counts[i] = child.getCountWithVirtualLoss();
+        has_virtual_loss |= (child.getVirtualLoss() != 0);
+        values[i] = 0.0f;
+        if (counts[i] == 0) { continue; }
+
+        float value = 1.0f;
+        if (!value_rescale || has_value_bound) {
+            value = child.getReward() + discount * child.getMean();
+            if (value_rescale) {
+                value = (value - value_lower_bound) / value_range;
+                value = fmin(1, fmax(-1, 2 * value - 1));
+            }
+            value = (child.getAction().getPlayer() == flipping_player ? -value : value);
+            value = (value * child.getCount() - child.getVirtualLoss()) / counts[i];
+        }
+        values[i] = value;
+        sum_of_values += value;
+        ++num_visited_children;
+    }
+
+    // score all children, then pick the best one; ties are broken by the larger policy
     int total_simulation = node->getCountWithVirtualLoss() - 1;
-    float init_q_value = calculateInitQValue(node);
+    float puct_bias = config::actor_mcts_puct_init + log((1 + total_simulation + config::actor_mcts_puct_base) / config::actor_mcts_puct_base);
+    const float puct_factor = puct_bias * sqrt(total_simulation);
+    const float init_q_value = calculateInitQValue(sum_of_values, num_visited_children);
+    calculatePUCTScores(num_children, puct_factor, init_q_value, policies.data(), counts.data(), values.data(), scores.data());
+    int selected = -1;
     float best_score = std::numeric_limits<float>::lowest(), best_policy = std::numeric_limits<float>::lowest();
-    for (int i = 0; i < node->getNumChildren(); ++i) {
-        MCTSNode* child = node->getChild(i);
-        float score = child->getNormalizedPUCTScore(total_simulation, tree_value_bound_, init_q_value);
-        if (score < best_score || (score == best_score && child->getPolicy() <= best_policy)) { continue; }
+    for (int i = 0; i < num_children; ++i) {
+        // proven losing children are only selected if no other child is left
+        const float score = (children[i].getSolverStatus() == SolverStatus::kLoss ? std::numeric_limits<float>::lowest() : scores[i]);
+        if (score < best_score || (score == best_score && policies[i] <= best_policy)) { continue; }
         best_score = score;
-        best_policy = child->getPolicy();
-        selected = child;
+        best_policy = policies[i];
+        selected = i;
     }
-    assert(selected != nullptr);
-    return selected;
+    assert(selected != -1);
+
+    // the next unexpanded child has the highest policy among the unexpanded ones and is scored as an unvisited child;
+    // children are only moved when no pending query passes through them, i.e., none of them has virtual loss
+    if (node->getUnexpandedChildrenDataIndex() != -1 && !has_virtual_loss && getNumChildrenToWiden(node) > 0) {
+        const ActionCandidate& candidate = tree_unexpanded_children_data_.getData(node->getUnexpandedChildrenDataIndex())[num_children];
+        if (puct_factor * candidate.policy_ + init_q_value > best_score) { return nullptr; }
+    }
+    return &children[selected];
 }
 
-float MCTS::calculateInitQValue(const MCTSNode* node) const
+int MCTS::getNumChildrenToWiden(const MCTSNode* node) const
 {
-    // init Q value = avg Q value of all visited children + one loss
-    assert(node && !node->isLeaf());
-    float sum_of_win = 0.0f, sum = 0.0f;
-    for (int i = 0; i < node->getNumChildren(); ++i) {
-        MCTSNode* child = node->getChild(i);
-        if (child->getCountWithVirtualLoss() == 0) { continue; }
-        sum_of_win += child->getNormalizedMean(tree_value_bound_);
-        sum += 1;
+    // double the expanded children each time, but keep enough free nodes for expanding the leaves of the remaining simulations
+    if (node->getUnexpandedChildrenDataIndex() == -1) { return 0; }
+    int num_candidates = tree_unexpanded_children_data_.getData(node->getUnexpandedChildrenDataIndex()).size();
+    int num_children = std::min(num_candidates, 2 * node->getNumChildren());
+    uint64_t num_simulation_left = std::max(0, config::actor_num_simulation + 1 - getNumSimulation());
+    uint64_t num_reserved_nodes = num_simulation_left * config::actor_mcts_num_expanded_children;
+    return (current_node_size_ + num_children + num_reserved_nodes <= 1 + tree_node_size_ ? num_children : 0);
+}
+
+MCTSNode* MCTS::expandMoreChildren(MCTSNode* node, int num_children)
+{
+    // children are contiguous, so they are copied to a larger block, and the old block is left unused until the tree is reset or reused
+    assert(node && node->getUnexpandedChildrenDataIndex() != -1 && num_children > node->getNumChildren());
+    const std::vector<ActionCandidate>& action_candidates = tree_unexpanded_children_data_.getData(node->getUnexpandedChildrenDataIndex());
+    assert(num_children <= static_cast<int>(action_candidates.size()));
+    int num_expanded_children = node->getNumChildren();
+    MCTSNode* first_child = allocateNodes(num_children);
+    for (int i = 0; i < num_expanded_children; ++i) { first_child[i] = *node->getChild(i); }
+    setChildren(first_child + num_expanded_children, action_candidates.data() + num_expanded_children, num_children - num_expanded_children);
+    node->setFirstChild(first_child);
+    node->setNumChildren(num_children);
+    if (num_children == static_cast<int>(action_candidates.size())) { node->setUnexpandedChildrenDataIndex(-1); }
+    return node->getChild(num_expanded_children);
+}
+
+void MCTS::setChildren(MCTSNode* first_child, const ActionCandidate* action_candidates, int size)
+{
+    for (int i = 0; i < size; ++i) {
+        const auto& candidate = action_candidates[i];
+        MCTSNode* child = first_child + i;
+        child->reset();
+        child->setAction(candidate.action_);
+        child->setPolicy(candidate.policy_);
+        child->setPolicyLogit(candidate.policy_logit_);
     }
+}
+
+void MCTS::calculatePUCTScores(int size, float puct_factor, float init_q_value, const float* policies, const float* counts, const float* values, float* scores) const
+{
+    // score = puct_factor * policy / (1 + count) + (count == 0 ? init_q_value : value)
+    int i = 0;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    static const bool use_avx2 = __builtin_cpu_supports("avx2");
+    if (use_avx2) { i = calculatePUCTScoresAVX2(size, puct_factor, init_q_value, policies, counts, values, scores); }
+#endif
+    for (; i < size; ++i) { scores[i] = puct_factor * policies[i] / (1 + counts[i]) + (counts[i] == 0 ? init_q_value : values[i]); }
+}
+
+float MCTS::calculateInitQValue(float sum_of_values, int num_visited_children) const
+{
+    // init Q value = avg Q value of all visited children + one loss
 #if ATARI
     // explore more in Atari games (TODO: check if this method also performs better in board games)
-    return (sum > 0 ? sum_of_win / sum : 1.0f);
+    return (num_visited_children > 0 ? sum_of_values / num_visited_children : 1.0f);
 #else
-    return (sum_of_win - 1) / (sum + 1);
+    return (sum_of_values - 1) / (num_visited_children + 1);
 #endif
 }
 
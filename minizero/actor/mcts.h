@@ -14,11 +14,19 @@
 
 namespace minizero::actor {
 
+// proven outcome of a node for the player who made its action
+enum class SolverStatus : char {
+    kUnsolved,
+    kWin,
+    kLoss,
+    kDraw
+};
+
 class MCTSNode : public TreeNode {
 public:
     MCTSNode() { reset(); }
 
-    void reset() override;
+    void reset() override final;
     virtual void add(float value, float weight = 1.0f);
     virtual void remove(float value, float weight = 1.0f);
     virtual float getNormalizedMean(const std::map<float, int>& tree_value_bound) const;
@@ -28,6 +36,8 @@ public:
 
     // setter
     inline void setHiddenStateDataIndex(int hidden_state_data_index) { hidden_state_data_index_ = hidden_state_data_index; }
+    inline void setUnexpandedChildrenDataIndex(int unexpanded_children_data_index) { unexpanded_children_data_index_ = unexpanded_children_data_index; }
+    inline void setSolverStatus(SolverStatus solver_status) { solver_status_ = solver_status; }
     inline void setMean(float mean) { mean_ = mean; }
     inline void setCount(float count) { count_ = count; }
     inline void addVirtualLoss(float num = 1.0f) { virtual_loss_ += num; }
@@ -41,6 +51,9 @@ public:
 
     // getter
     inline int getHiddenStateDataIndex() const { return hidden_state_data_index_; }
+    inline int getUnexpandedChildrenDataIndex() const { return unexpanded_children_data_index_; }
+    inline SolverStatus getSolverStatus() const { return solver_status_; }
+    inline bool isSolved() const { return solver_status_ != SolverStatus::kUnsolved; }
     inline float getMean() const { return mean_; }
     inline float getCount() const { return count_; }
     inline float getCountWithVirtualLoss() const { return count_ + virtual_loss_; }
@@ -50,10 +63,12 @@ public:
     inline float getPolicyNoise() const { return policy_noise_; }
     inline float getValue() const { return value_; }
     inline float getReward() const { return reward_; }
-    inline virtual MCTSNode* getChild(int index) const override { return (index < num_children_ ? static_cast<MCTSNode*>(first_child_) + index : nullptr); }
+    inline MCTSNode* getChild(int index) const override final { return (index < num_children_ ? static_cast<MCTSNode*>(first_child_) + index : nullptr); }
 
 protected:
     int hidden_state_data_index_;
+    int unexpanded_children_data_index_;
+    SolverStatus solver_status_;
     float mean_;
     float count_;
     float virtual_loss_;
@@ -84,20 +99,27 @@ public:
     };
 
     MCTS(uint64_t tree_node_size)
-        : Tree(tree_node_size) {}
+        : Tree(tree_node_size), num_reused_simulation_(0) {}
 
     void reset() override;
     virtual bool isResign(const MCTSNode* selected_node) const;
     virtual MCTSNode* selectChildByMaxCount(const MCTSNode* node) const;
     virtual MCTSNode* selectChildBySoftmaxCount(const MCTSNode* node, float temperature = 1.0f, float value_threshold = 0.1f) const;
+    virtual MCTSNode* selectChildBySolverStatus(const MCTSNode* node) const;
     virtual std::string getSearchDistributionString() const;
     virtual std::vector<MCTSNode*> select() { return selectFromNode(getRootNode()); }
     virtual std::vector<MCTSNode*> selectFromNode(MCTSNode* start_node);
     virtual void expand(MCTSNode* leaf_node, const std::vector<ActionCandidate>& action_candidates);
+    virtual bool expandAllChildren(MCTSNode* node);
     virtual void backup(const std::vector<MCTSNode*>& node_path, const float value, const float reward = 0.0f);
+    virtual void reuseSubtree(MCTSNode* new_root);
+    virtual void solveLeaf(MCTSNode* leaf_node, float value);
+    virtual void propagateSolverStatus(const std::vector<MCTSNode*>& node_path);
+    virtual float getSolvedValue(const MCTSNode* node) const;
 
     inline MCTSNode* allocateNodes(int size) { return static_cast<MCTSNode*>(Tree::allocateNodes(size)); }
-    inline int getNumSimulation() const { return getRootNode()->getCount(); }
+    inline int getNumSimulation() const { return getRootNode()->getCount() - num_reused_simulation_; }
+    inline int getNumReusedSimulation() const { return num_reused_simulation_; }
     inline bool reachMaximumSimulation() const { return (getNumSimulation() == config::actor_num_simulation + 1); }
     inline MCTSNode* getRootNode() { return static_cast<MCTSNode*>(Tree::getRootNode()); }
     inline const MCTSNode* getRootNode() const { return static_cast<const MCTSNode*>(Tree::getRootNode()); }
@@ -107,15 +129,23 @@ public:
     inline const std::map<float, int>& getTreeValueBound() const { return tree_value_bound_; }
 
 protected:
-    TreeNode* createTreeNodes(uint64_t tree_node_size) override { return new MCTSNode[tree_node_size]; }
-    TreeNode* getNodeIndex(int index) override { return getRootNode() + index; }
-
-    virtual MCTSNode* selectChildByPUCTScore(const MCTSNode* node) const;
-    virtual float calculateInitQValue(const MCTSNode* node) const;
+    std::shared_ptr<TreeNode> createTreeNodes(uint64_t tree_node_size) override { return std::shared_ptr<TreeNode>(new MCTSNode[tree_node_size], std::default_delete<MCTSNode[]>()); }
+    TreeNode* getNodeIndex(TreeNode* first_node, uint64_t index) override { return static_cast<MCTSNode*>(first_node) + index; }
+    uint64_t getNodeOffset(const TreeNode* first_node, const TreeNode* node) const override { return static_cast<const MCTSNode*>(node) - static_cast<const MCTSNode*>(first_node); }
+
+    virtual MCTSNode* selectChildByPUCTScore(const MCTSNode* node) const; // returns nullptr if the next unexpanded child is selected
+    virtual int getNumChildrenToWiden(const MCTSNode* node) const;
+    virtual MCTSNode* expandMoreChildren(MCTSNode* node, int num_children);
+    void setChildren(MCTSNode* first_child, const ActionCandidate* action_candidates, int size);
+    virtual SolverStatus calculateSolverStatus(const MCTSNode* node) const;
+    virtual float calculateInitQValue(float sum_of_values, int num_visited_children) const;
+    void calculatePUCTScores(int size, float puct_factor, float init_q_value, const float* policies, const float* counts, const float* values, float* scores) const;
     virtual void updateTreeValueBound(float old_value, float new_value);
 
+    int num_reused_simulation_;
     std::map<float, int> tree_value_bound_;
     TreeHiddenStateData tree_hidden_state_data_;
+    TreeData<std::vector<ActionCandidate>> tree_unexpanded_children_data_; // all action candidates sorted by policy, for nodes not fully expanded
 };
 
 } // namespace minizero::actor
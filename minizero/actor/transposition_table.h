@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace minizero::actor {
+
+// fixed-size, direct-mapped table; a new entry always replaces the one in its slot
+template <class Data>
+class TranspositionTable {
+public:
+    TranspositionTable(int size = 0) : entries_(size) {}
+
+    inline void clear()
+    {
+        for (auto& entry : entries_) { entry.key_ = 0; }
+    }
+    inline bool isEnabled() const { return !entries_.empty(); }
+    inline const Data* lookup(uint64_t key) const
+    {
+        if (!isEnabled() || key == 0) { return nullptr; }
+        const Entry& entry = entries_[key % entries_.size()];
+        return (entry.key_ == key ? &entry.data_ : nullptr);
+    }
+    inline void store(uint64_t key, const Data& data)
+    {
+        if (!isEnabled() || key == 0) { return; }
+        Entry& entry = entries_[key % entries_.size()];
+        entry.key_ = key;
+        entry.data_ = data;
+    }
+
+private:
+    class Entry {
+    public:
+        uint64_t key_ = 0;
+        Data data_;
+    };
+    std::vector<Entry> entries_;
+};
+
+} // namespace minizero::actor
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace minizero::actor {
@@ -56,22 +59,35 @@ class Tree {
 public:
     Tree(uint64_t tree_node_size)
         : tree_node_size_(tree_node_size),
-          nodes_(nullptr)
+          current_node_size_(0),
+          current_chunk_(0),
+          current_chunk_offset_(0),
+          allocated_node_size_(0)
     {
         assert(tree_node_size >= 0);
     }
 
+    // nodes are allocated in chunks on demand, and the chunks are kept for the following searches
     inline void reset()
     {
-        if (!nodes_) { nodes_ = createTreeNodes(1 + tree_node_size_); }
+        if (chunks_.empty()) { addChunk(0, 1); }
         current_node_size_ = 1;
+        current_chunk_ = 0;
+        current_chunk_offset_ = 1;
         getRootNode()->reset();
     }
 
     inline TreeNode* allocateNodes(int size)
     {
         assert(current_node_size_ + size <= 1 + tree_node_size_);
-        TreeNode* node = getNodeIndex(current_node_size_);
+        if (current_chunk_offset_ + size > chunks_[current_chunk_].second) {
+            // the children of a node are contiguous, so move to the next chunk if the rest of this chunk is too small
+            ++current_chunk_;
+            current_chunk_offset_ = 0;
+            if (current_chunk_ == chunks_.size() || chunks_[current_chunk_].second < static_cast<uint64_t>(size)) { addChunk(current_chunk_, size); }
+        }
+        TreeNode* node = getNodeIndex(chunks_[current_chunk_].first.get(), current_chunk_offset_);
+        current_chunk_offset_ += size;
         current_node_size_ += size;
         return node;
     }
@@ -109,16 +125,43 @@ public:
         return oss.str();
     }
 
-    inline TreeNode* getRootNode() { return &nodes_[0]; }
-    inline const TreeNode* getRootNode() const { return &nodes_[0]; }
+    inline TreeNode* getRootNode() { return chunks_[0].first.get(); }
+    inline const TreeNode* getRootNode() const { return chunks_[0].first.get(); }
+    inline uint64_t getNumUsedNodes() const { return current_node_size_; }
+    inline uint64_t getNumAllocatedNodes() const { return allocated_node_size_; }
 
 protected:
-    virtual TreeNode* createTreeNodes(uint64_t tree_node_size) = 0;
-    virtual TreeNode* getNodeIndex(int index) = 0;
+    inline void addChunk(size_t chunk_index, uint64_t min_size)
+    {
+        // chunks are small for small trees, so that the memory never exceeds the preallocated tree much
+        const uint64_t kTreeChunkSize = 8192;
+        uint64_t chunk_size = std::max(min_size, std::min(kTreeChunkSize, 1 + tree_node_size_ - std::min(allocated_node_size_, tree_node_size_)));
+        chunks_.insert(chunks_.begin() + chunk_index, {createTreeNodes(chunk_size), chunk_size});
+        allocated_node_size_ += chunk_size;
+    }
+
+    // returns the position of a node in allocation order, i.e., (chunk index, offset in the chunk)
+    std::pair<size_t, uint64_t> getNodeOrder(const TreeNode* node) const
+    {
+        for (size_t i = 0; i < chunks_.size(); ++i) {
+            const TreeNode* first_node = chunks_[i].first.get();
+            uint64_t offset = getNodeOffset(first_node, node);
+            if (node >= first_node && offset < chunks_[i].second) { return {i, offset}; }
+        }
+        assert(false);
+        return {chunks_.size(), 0};
+    }
+
+    virtual std::shared_ptr<TreeNode> createTreeNodes(uint64_t tree_node_size) = 0;
+    virtual TreeNode* getNodeIndex(TreeNode* first_node, uint64_t index) = 0;
+    virtual uint64_t getNodeOffset(const TreeNode* first_node, const TreeNode* node) const = 0;
 
     uint64_t tree_node_size_;
     uint64_t current_node_size_;
-    TreeNode* nodes_;
+    size_t current_chunk_;
+    uint64_t current_chunk_offset_;
+    uint64_t allocated_node_size_;
+    std::vector<std::pair<std::shared_ptr<TreeNode>, uint64_t>> chunks_; // (nodes, size)
 };
 
 } // namespace minizero::actor
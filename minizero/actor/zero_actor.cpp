@@ -1,9 +1,10 @@
 #include "zero_actor.h"
 #include "random.h"
-#include "time_system.h"
 #include <algorithm>
+#include <boost/thread.hpp>
+#include <condition_variable>
 #include <memory>
-#include <tuple>
+#include <mutex>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -18,85 +19,238 @@ void MCTSSearchData::clear()
     search_info_ = "";
     selected_node_ = nullptr;
     node_path_.clear();
+    leaf_queries_.clear();
 }
 
 void ZeroActor::reset()
 {
     BaseActor::reset();
+    transposition_table_.clear();
     enable_resign_ = (utils::Random::randReal() < config::zero_disable_resign_ratio ? false : true);
 }
 
 void ZeroActor::resetSearch()
 {
-    BaseActor::resetSearch();
+    MCTSNode* subtree_root = findReusableSubtreeRoot();
+    if (subtree_root) {
+        nn_evaluation_batch_id_ = -1;
+        getMCTS()->reuseSubtree(subtree_root);
+        // keep at least tree_node_size_ free nodes for the new search
+        if (getMCTS()->getNumUsedNodes() > tree_node_size_) { subtree_root = nullptr; }
+    }
+    if (!subtree_root) { BaseActor::resetSearch(); }
+    mcts_search_data_.selected_node_ = nullptr; // may point into a node slot overwritten by reuseSubtree()
     mcts_search_data_.node_path_.clear();
+    mcts_search_data_.leaf_queries_.clear();
     getMCTS()->getRootNode()->setAction(Action(-1, env::getPreviousPlayer(env_.getTurn(), env_.getNumPlayer())));
+    tree_root_action_history_ = env_.getActionHistory();
+    if (subtree_root) { addNoiseToNodeChildren(getMCTS()->getRootNode()); }
 }
 
 Action ZeroActor::think(bool with_play /*= false*/, bool display_board /*= false*/)
 {
     resetSearch();
     boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
-    while (!isSearchDone()) {
-        step();
-        int spent_million_second = (utils::TimeSystem::getLocalTime() - start_ptime).total_milliseconds();
-        if (config::actor_mcts_think_time_limit > 0 && spent_million_second >= config::actor_mcts_think_time_limit * 1000) { break; }
+    if (!think_workers_.empty() && !config::actor_use_gumbel) {
+        thinkInParallel(start_ptime);
+    } else {
+        while (!isSearchDone()) {
+            step();
+            if (isThinkTimeUp(start_ptime)) { break; }
+        }
+        // also decide when the search ends without any step, e.g., the reused root is already solved
+        if (!mcts_search_data_.selected_node_) { handleSearchDone(); }
     }
-    if (!isSearchDone()) { handleSearchDone(); }
     if (with_play) { act(getSearchAction()); }
     if (display_board) { std::cerr << env_.toString() << mcts_search_data_.search_info_ << std::endl; }
     return getSearchAction();
 }
 
-void ZeroActor::beforeNNEvaluation()
+void ZeroActor::afterNNEvaluation(const std::shared_ptr<NetworkOutputBatch>& network_output_batch)
+{
+    assert(network_output_batch);
+    for (size_t query_index = 0; query_index < mcts_search_data_.leaf_queries_.size(); ++query_index) {
+        const MCTSLeafQuery& query = mcts_search_data_.leaf_queries_[query_index];
+        feature_rotation_ = query.rotation_;
+        mcts_search_data_.node_path_ = query.node_path_;
+        for (auto node : mcts_search_data_.node_path_) { node->removeVirtualLoss(); }
+        afterLeafEvaluation(network_output_batch, query_index);
+    }
+    mcts_search_data_.leaf_queries_.clear();
+    if (isSearchDone() && !is_thinking_in_parallel_) { handleSearchDone(); }
+}
+
+void ZeroActor::selectLeaves(int max_batch_size)
+{
+    assert(alphazero_network_ || muzero_network_);
+
+    // a leaf that is already pending ends the batch, so that each network evaluation is backed up only once
+    std::vector<MCTSLeafQuery>& leaf_queries = mcts_search_data_.leaf_queries_;
+    leaf_queries.clear();
+    while (static_cast<int>(leaf_queries.size()) < max_batch_size) {
+        // the virtual loss of the root counts the pending leaves of all threads sharing the tree
+        int num_simulation = getMCTS()->getNumSimulation();
+        int num_pending_simulation = getMCTS()->getRootNode()->getVirtualLoss();
+        int num_simulation_left = config::actor_num_simulation + 1 - num_simulation - num_pending_simulation;
+        if (num_simulation_left <= 0 || isSearchDone() || (num_simulation == 0 && num_pending_simulation > 0 /* evaluate root node first */)) { break; }
+
+        beforeLeafEvaluation();
+        if (mcts_search_data_.node_path_.back()->getVirtualLoss() > 0) { break; }
+        if (nn_evaluation_batch_id_ < 0) { continue; } // already evaluated by the transposition table
+        int evaluation_cache_generation = (alphazero_network_ && alphazero_network_->getEvaluationCache() ? alphazero_network_->getEvaluationCache()->getGeneration() : 0);
+        leaf_queries.push_back({nn_evaluation_batch_id_, evaluation_cache_generation, feature_rotation_, mcts_search_data_.node_path_});
+        for (auto node : mcts_search_data_.node_path_) { node->addVirtualLoss(); }
+    }
+    nn_evaluation_batch_id_ = (leaf_queries.empty() ? -1 : leaf_queries.front().batch_id_);
+    if (leaf_queries.empty() && isSearchDone() && !is_thinking_in_parallel_) { handleSearchDone(); }
+}
+
+void ZeroActor::beforeLeafEvaluation()
 {
-    mcts_search_data_.node_path_ = selection();
+    // always evaluate the root first, even if it is reused, so that each search starts with one initial inference of the current environment
+    mcts_search_data_.node_path_ = (getMCTS()->getNumSimulation() == 0 ? std::vector<MCTSNode*>{getMCTS()->getRootNode()} : selection());
+    if (mcts_search_data_.node_path_.back()->getVirtualLoss() > 0) { // the leaf is pending evaluation
+        nn_evaluation_batch_id_ = -1;
+        return;
+    }
     if (alphazero_network_) {
-        Environment env_transition = getEnvironmentTransition(mcts_search_data_.node_path_);
+        const Environment& env_transition = getEnvironmentTransition(mcts_search_data_.leaf_queries_.size(), mcts_search_data_.node_path_);
         feature_rotation_ = config::actor_use_random_rotation_features ? static_cast<utils::Rotation>(utils::Random::randInt() % static_cast<int>(utils::Rotation::kRotateSize)) : utils::Rotation::kRotationNone;
-        nn_evaluation_batch_id_ = alphazero_network_->pushBack(env_transition.getFeatures(feature_rotation_));
+        if (evaluateLeafBySolver(env_transition) || evaluateLeafByTranspositionTable(env_transition) || evaluateLeafByEvaluationCache(env_transition)) {
+            nn_evaluation_batch_id_ = -1;
+            return;
+        }
+        nn_evaluation_batch_id_ = alphazero_network_->reserveBatchIndex();
+        env_transition.fillFeatures(alphazero_network_->getInputData(nn_evaluation_batch_id_), feature_rotation_);
     } else if (muzero_network_) {
         if (getMCTS()->getNumSimulation() == 0) { // initial inference for root node
-            nn_evaluation_batch_id_ = muzero_network_->pushBackInitialData(env_.getFeatures());
+            nn_evaluation_batch_id_ = muzero_network_->reserveInitialBatchIndex();
+            env_.fillFeatures(muzero_network_->getInitialInputData(nn_evaluation_batch_id_));
         } else { // for non-root nodes
             const std::vector<MCTSNode*>& node_path = mcts_search_data_.node_path_;
             MCTSNode* leaf_node = node_path.back();
             MCTSNode* parent_node = node_path[node_path.size() - 2];
             assert(parent_node && parent_node->getHiddenStateDataIndex() != -1);
             const std::vector<float>& hidden_state = getMCTS()->getTreeHiddenStateData().getData(parent_node->getHiddenStateDataIndex()).hidden_state_;
-            nn_evaluation_batch_id_ = muzero_network_->pushBackRecurrentData(hidden_state, env_.getActionFeatures(leaf_node->getAction()));
+            std::vector<float> action_features = env_.getActionFeatures(leaf_node->getAction());
+            nn_evaluation_batch_id_ = muzero_network_->reserveRecurrentBatchIndex();
+            std::copy(hidden_state.begin(), hidden_state.end(), muzero_network_->getRecurrentFeatureInputData(nn_evaluation_batch_id_));
+            std::copy(action_features.begin(), action_features.end(), muzero_network_->getRecurrentActionInputData(nn_evaluation_batch_id_));
         }
     } else {
         assert(false);
     }
 }
 
-void ZeroActor::afterNNEvaluation(const std::shared_ptr<NetworkOutput>& network_output)
+void ZeroActor::afterLeafEvaluation(const std::shared_ptr<NetworkOutputBatch>& network_output_batch, int query_index)
 {
+    const int batch_id = mcts_search_data_.leaf_queries_[query_index].batch_id_;
     const std::vector<MCTSNode*>& node_path = mcts_search_data_.node_path_;
     MCTSNode* leaf_node = node_path.back();
+    bool is_expanded = !leaf_node->isLeaf(); // a reused root is evaluated again
     if (alphazero_network_) {
-        Environment env_transition = getEnvironmentTransition(node_path);
+        const Environment& env_transition = mcts_search_data_.env_transitions_[query_index];
         if (!env_transition.isTerminal()) {
-            std::shared_ptr<AlphaZeroNetworkOutput> alphazero_output = std::static_pointer_cast<AlphaZeroNetworkOutput>(network_output);
-            getMCTS()->expand(leaf_node, calculateAlphaZeroActionPolicy(env_transition, alphazero_output, feature_rotation_));
-            getMCTS()->backup(node_path, alphazero_output->value_, env_transition.getReward());
+            AlphaZeroNetworkOutput alphazero_output = std::static_pointer_cast<AlphaZeroNetworkOutputBatch>(network_output_batch)->getOutput(batch_id);
+            if (!is_expanded) {
+                std::vector<MCTS::ActionCandidate> action_candidates = calculateAlphaZeroActionPolicy(env_transition, alphazero_output, feature_rotation_);
+                getMCTS()->expand(leaf_node, action_candidates);
+                transposition_table_.store(env_transition.getFeatureHashKey(), {alphazero_output.value_, std::move(action_candidates)});
+            }
+            const auto& evaluation_cache = alphazero_network_->getEvaluationCache();
+            if (evaluation_cache && evaluation_cache->isEnabled()) {
+                const MCTSLeafQuery& query = mcts_search_data_.leaf_queries_[query_index];
+                evaluation_cache->insert(getEvaluationCacheKey(env_transition, feature_rotation_), query.evaluation_cache_generation_, std::make_shared<AlphaZeroNetworkEvaluation>(alphazero_output));
+            }
+            getMCTS()->backup(node_path, alphazero_output.value_, env_transition.getReward());
         } else {
             getMCTS()->backup(node_path, env_transition.getEvalScore(), env_transition.getReward());
         }
     } else if (muzero_network_) {
-        std::shared_ptr<MuZeroNetworkOutput> muzero_output = std::static_pointer_cast<MuZeroNetworkOutput>(network_output);
-        getMCTS()->expand(leaf_node, calculateMuZeroActionPolicy(leaf_node, muzero_output));
-        getMCTS()->backup(node_path, muzero_output->value_, muzero_output->reward_);
-        leaf_node->setHiddenStateDataIndex(getMCTS()->getTreeHiddenStateData().store(HiddenStateData(muzero_output->hidden_state_)));
+        MuZeroNetworkOutput muzero_output = std::static_pointer_cast<MuZeroNetworkOutputBatch>(network_output_batch)->getOutput(batch_id);
+        if (!is_expanded) { getMCTS()->expand(leaf_node, calculateMuZeroActionPolicy(leaf_node, muzero_output)); }
+        getMCTS()->backup(node_path, muzero_output.value_, muzero_output.reward_);
+        if (!is_expanded) {
+            std::vector<float> hidden_state(muzero_output.hidden_state_, muzero_output.hidden_state_ + muzero_output.hidden_state_size_);
+            leaf_node->setHiddenStateDataIndex(getMCTS()->getTreeHiddenStateData().store(HiddenStateData(hidden_state)));
+        }
     } else {
         assert(false);
     }
-    if (leaf_node == getMCTS()->getRootNode()) { addNoiseToNodeChildren(leaf_node); }
-    if (isSearchDone()) { handleSearchDone(); }
+    if (!is_expanded && leaf_node == getMCTS()->getRootNode()) { addNoiseToNodeChildren(leaf_node); }
     if (config::actor_use_gumbel) { gumbel_zero_.sequentialHalving(getMCTS()); }
 }
 
+bool ZeroActor::evaluateLeafBySolver(const Environment& env_transition)
+{
+    // terminal and proven leaves are backed up with their proven values instead of network evaluations
+    const std::vector<MCTSNode*>& node_path = mcts_search_data_.node_path_;
+    MCTSNode* leaf_node = node_path.back();
+    if (!isSolverEnabled() || (!env_transition.isTerminal() && !leaf_node->isSolved())) { return false; }
+    if (!leaf_node->isSolved()) {
+        getMCTS()->solveLeaf(leaf_node, env_transition.getEvalScore());
+        getMCTS()->propagateSolverStatus(node_path);
+    }
+    getMCTS()->backup(node_path, getMCTS()->getSolvedValue(leaf_node), env_transition.getReward());
+    if (config::actor_use_gumbel) { gumbel_zero_.sequentialHalving(getMCTS()); }
+    return true;
+}
+
+bool ZeroActor::evaluateLeafByTranspositionTable(const Environment& env_transition)
+{
+    if (!transposition_table_.isEnabled() || env_transition.isTerminal()) { return false; }
+    const MCTSTranspositionData* transposition_data = transposition_table_.lookup(env_transition.getFeatureHashKey());
+    if (!transposition_data) { return false; }
+
+    const std::vector<MCTSNode*>& node_path = mcts_search_data_.node_path_;
+    MCTSNode* leaf_node = node_path.back();
+    if (leaf_node->isLeaf()) {
+        // check legality again since it may depend on history beyond the hash key, e.g., superko
+        std::vector<MCTS::ActionCandidate> action_candidates;
+        for (const auto& candidate : transposition_data->action_candidates_) {
+            if (env_transition.isLegalAction(candidate.action_)) { action_candidates.push_back(candidate); }
+        }
+        getMCTS()->expand(leaf_node, action_candidates);
+        if (leaf_node == getMCTS()->getRootNode()) { addNoiseToNodeChildren(leaf_node); }
+    }
+    getMCTS()->backup(node_path, transposition_data->value_, env_transition.getReward());
+    if (config::actor_use_gumbel) { gumbel_zero_.sequentialHalving(getMCTS()); }
+    return true;
+}
+
+bool ZeroActor::evaluateLeafByEvaluationCache(const Environment& env_transition)
+{
+    const std::shared_ptr<AlphaZeroEvaluationCache>& evaluation_cache = alphazero_network_->getEvaluationCache();
+    if (!evaluation_cache || !evaluation_cache->isEnabled() || env_transition.isTerminal()) { return false; }
+    std::shared_ptr<const AlphaZeroNetworkEvaluation> evaluation = evaluation_cache->lookup(getEvaluationCacheKey(env_transition, feature_rotation_));
+    if (!evaluation) { return false; }
+
+    // the cached output is the network output of the same position and rotation, so it is used as if it came from the current batch
+    const std::vector<MCTSNode*>& node_path = mcts_search_data_.node_path_;
+    MCTSNode* leaf_node = node_path.back();
+    AlphaZeroNetworkOutput alphazero_output = evaluation->getOutput();
+    if (leaf_node->isLeaf()) {
+        std::vector<MCTS::ActionCandidate> action_candidates = calculateAlphaZeroActionPolicy(env_transition, alphazero_output, feature_rotation_);
+        getMCTS()->expand(leaf_node, action_candidates);
+        transposition_table_.store(env_transition.getFeatureHashKey(), {alphazero_output.value_, std::move(action_candidates)});
+        if (leaf_node == getMCTS()->getRootNode()) { addNoiseToNodeChildren(leaf_node); }
+    }
+    getMCTS()->backup(node_path, alphazero_output.value_, env_transition.getReward());
+    if (config::actor_use_gumbel) { gumbel_zero_.sequentialHalving(getMCTS()); }
+    return true;
+}
+
+void ZeroActor::setThinkNetworks(const std::vector<std::shared_ptr<network::Network>>& networks)
+{
+    // each worker searches the tree of this actor with its own network, see thinkInParallel()
+    think_workers_.clear();
+    for (const auto& network : networks) {
+        think_workers_.push_back(std::make_shared<ZeroActor>(tree_node_size_));
+        think_workers_.back()->setNetwork(network);
+        think_workers_.back()->is_thinking_in_parallel_ = true;
+    }
+}
+
 void ZeroActor::setNetwork(const std::shared_ptr<network::Network>& network)
 {
     assert(network);
@@ -110,6 +264,7 @@ void ZeroActor::setNetwork(const std::shared_ptr<network::Network>& network)
         assert(false);
     }
     assert((alphazero_network_ && !muzero_network_) || (!alphazero_network_ && muzero_network_));
+    transposition_table_.clear(); // cached evaluations belong to the previous model
 }
 
 std::vector<std::pair<std::string, std::string>> ZeroActor::getActionInfo() const
@@ -128,32 +283,63 @@ std::string ZeroActor::getEnvReward() const
 
 void ZeroActor::step()
 {
-    assert(alphazero_network_ || muzero_network_);
-    int num_simulation = getMCTS()->getNumSimulation();
-    int num_simulation_left = config::actor_num_simulation + 1 - num_simulation;
-    int batch_size = std::min(config::actor_mcts_think_batch_size,
-                              (alphazero_network_ || num_simulation > 0) ? num_simulation_left : 1 /* initial inference for root node */);
-    assert(batch_size > 0);
-
-    std::vector<std::tuple<int, utils::Rotation, decltype(mcts_search_data_.node_path_)>> batch_queries; // batch id, rotation, search path
-    for (int batch_id = 0; batch_id < batch_size; batch_id++) {
-        beforeNNEvaluation();
-        assert(nn_evaluation_batch_id_ == batch_id);
-        if (mcts_search_data_.node_path_.back()->getVirtualLoss() == 0) {
-            batch_queries.emplace_back(nn_evaluation_batch_id_, feature_rotation_, mcts_search_data_.node_path_);
+    bool is_initial_inference = (getMCTS()->getNumSimulation() == 0);
+    selectLeaves(config::actor_mcts_think_batch_size);
+    if (mcts_search_data_.leaf_queries_.empty()) { return; }
+    afterNNEvaluation(forward(is_initial_inference));
+}
+
+void ZeroActor::thinkInParallel(const boost::posix_time::ptime& start_ptime)
+{
+    // tree parallelization: this actor and the workers share the tree and only access it under the mutex,
+    // so the network forward of each thread overlaps the selection and backup of the others; virtual loss spreads their leaves
+    std::mutex tree_mutex;
+    std::condition_variable tree_cv;
+    auto search = [this, &tree_mutex, &tree_cv, &start_ptime](ZeroActor* actor) {
+        // every thread finishes its evaluating batch before leaving, so no leaf is left with virtual loss
+        std::unique_lock<std::mutex> lock(tree_mutex);
+        while (!isSearchDone() && !isThinkTimeUp(start_ptime)) {
+            bool is_initial_inference = (getMCTS()->getNumSimulation() == 0);
+            actor->selectLeaves(config::actor_mcts_think_batch_size);
+            if (actor->mcts_search_data_.leaf_queries_.empty()) {
+                // the root or the last simulations are being evaluated by other threads, which notify after their backup
+                tree_cv.wait(lock);
+                continue;
+            }
+            lock.unlock();
+            std::shared_ptr<NetworkOutputBatch> network_output_batch = actor->forward(is_initial_inference);
+            lock.lock();
+            actor->afterNNEvaluation(network_output_batch);
+            tree_cv.notify_all();
         }
-        for (auto node : mcts_search_data_.node_path_) { node->addVirtualLoss(); }
-    }
-    auto network_output = alphazero_network_ ? alphazero_network_->forward()
-                                             : (num_simulation == 0 ? muzero_network_->initialInference() : muzero_network_->recurrentInference());
-    for (auto& query : batch_queries) {
-        nn_evaluation_batch_id_ = std::get<0>(query);
-        feature_rotation_ = std::get<1>(query);
-        mcts_search_data_.node_path_ = std::get<2>(query);
-        afterNNEvaluation(network_output[nn_evaluation_batch_id_]);
-        auto virtual_loss = mcts_search_data_.node_path_.back()->getVirtualLoss();
-        for (auto node : mcts_search_data_.node_path_) { node->removeVirtualLoss(virtual_loss); }
+        tree_cv.notify_all();
+    };
+
+    is_thinking_in_parallel_ = true;
+    boost::thread_group threads;
+    for (auto& worker : think_workers_) {
+        worker->env_ = env_;
+        worker->search_ = search_;
+        worker->mcts_search_data_.clear();
+        worker->transposition_table_.clear(); // workers are not reset with this actor, so their cached evaluations are dropped every move
+        threads.create_thread([&search, &worker]() { search(worker.get()); });
     }
+    search(this);
+    threads.join_all();
+    is_thinking_in_parallel_ = false;
+    handleSearchDone();
+}
+
+bool ZeroActor::isThinkTimeUp(const boost::posix_time::ptime& start_ptime) const
+{
+    int spent_million_second = (utils::TimeSystem::getLocalTime() - start_ptime).total_milliseconds();
+    return (config::actor_mcts_think_time_limit > 0 && spent_million_second >= config::actor_mcts_think_time_limit * 1000);
+}
+
+std::shared_ptr<NetworkOutputBatch> ZeroActor::forward(bool is_initial_inference)
+{
+    return (alphazero_network_ ? alphazero_network_->forward()
+                               : (is_initial_inference ? muzero_network_->initialInference() : muzero_network_->recurrentInference()));
 }
 
 void ZeroActor::handleSearchDone()
@@ -168,6 +354,7 @@ void ZeroActor::handleSearchDone()
         << " (" << action.getActionID() << ")"
         << ", reward: " << env_.getReward()
         << ", player: " << env::playerToChar(action.getPlayer());
+    if (config::actor_mcts_tree_reuse) { oss << ", reused simulation: " << getMCTS()->getNumReusedSimulation(); }
     if (config::actor_mcts_value_rescale) { oss << ", value bound: (" << getMCTS()->getTreeValueBound().begin()->first << ", " << getMCTS()->getTreeValueBound().rbegin()->first << ")"; }
     oss << std::endl
         << "  root node info: " << getMCTS()->getRootNode()->toString() << std::endl
@@ -180,6 +367,9 @@ MCTSNode* ZeroActor::decideActionNode()
     if (config::actor_use_gumbel) {
         return gumbel_zero_.decideActionNode(getMCTS());
     } else {
+        if (isSolverEnabled()) {
+            if (MCTSNode* child = getMCTS()->selectChildBySolverStatus(getMCTS()->getRootNode())) { return child; }
+        }
         if (config::actor_select_action_by_count) {
             return getMCTS()->selectChildByMaxCount(getMCTS()->getRootNode());
         } else if (config::actor_select_action_by_softmax_count) {
@@ -191,6 +381,47 @@ MCTSNode* ZeroActor::decideActionNode()
     }
 }
 
+MCTSNode* ZeroActor::findReusableSubtreeRoot()
+{
+    if (!config::actor_mcts_tree_reuse || config::actor_use_gumbel || !search_) { return nullptr; }
+
+    // follow the actions played since the last search from the previous root
+    const std::vector<Action>& action_history = env_.getActionHistory();
+    if (action_history.size() <= tree_root_action_history_.size() || getMCTS()->getRootNode()->isLeaf()) { return nullptr; }
+    for (size_t i = 0; i < tree_root_action_history_.size(); ++i) {
+        if (action_history[i].getActionID() != tree_root_action_history_[i].getActionID() || action_history[i].getPlayer() != tree_root_action_history_[i].getPlayer()) { return nullptr; }
+    }
+    MCTSNode* node = getMCTS()->getRootNode();
+    for (size_t i = tree_root_action_history_.size(); i < action_history.size() && node; ++i) {
+        MCTSNode* child = nullptr;
+        for (int j = 0; j < node->getNumChildren(); ++j) {
+            const Action& action = node->getChild(j)->getAction();
+            if (action.getActionID() == action_history[i].getActionID() && action.getPlayer() == action_history[i].getPlayer()) {
+                child = node->getChild(j);
+                break;
+            }
+        }
+        node = child;
+    }
+    if (!node || node->isLeaf() || node->getChild(0)->getAction().getPlayer() != env_.getTurn()) { return nullptr; }
+
+    // the root needs all children for the noise and the action decision
+    if (!getMCTS()->expandAllChildren(node)) { return nullptr; }
+
+    // muzero only filters illegal actions at the root, so move the legal children to the front of the block
+    if (muzero_network_) {
+        int num_legal_children = 0;
+        for (int i = 0; i < node->getNumChildren(); ++i) {
+            if (!env_.isLegalAction(node->getChild(i)->getAction())) { continue; }
+            if (i != num_legal_children) { std::swap(*node->getChild(i), *node->getChild(num_legal_children)); }
+            ++num_legal_children;
+        }
+        if (num_legal_children == 0) { return nullptr; }
+        node->setNumChildren(num_legal_children);
+    }
+    return node;
+}
+
 void ZeroActor::addNoiseToNodeChildren(MCTSNode* node)
 {
     assert(node && node->getNumChildren() > 0);
@@ -212,15 +443,15 @@ void ZeroActor::addNoiseToNodeChildren(MCTSNode* node)
     }
 }
 
-std::vector<MCTS::ActionCandidate> ZeroActor::calculateAlphaZeroActionPolicy(const Environment& env_transition, const std::shared_ptr<network::AlphaZeroNetworkOutput>& alphazero_output, const utils::Rotation& rotation)
+std::vector<MCTS::ActionCandidate> ZeroActor::calculateAlphaZeroActionPolicy(const Environment& env_transition, const network::AlphaZeroNetworkOutput& alphazero_output, const utils::Rotation& rotation)
 {
     assert(alphazero_network_);
     std::vector<MCTS::ActionCandidate> action_candidates;
-    for (size_t action_id = 0; action_id < alphazero_output->policy_.size(); ++action_id) {
+    for (int action_id = 0; action_id < alphazero_output.policy_size_; ++action_id) {
         Action action(action_id, env_transition.getTurn());
         if (!env_transition.isLegalAction(action)) { continue; }
         int rotated_id = env_transition.getRotateAction(action_id, rotation);
-        action_candidates.push_back(MCTS::ActionCandidate(action, alphazero_output->policy_[rotated_id], alphazero_output->policy_logits_[rotated_id]));
+        action_candidates.push_back(MCTS::ActionCandidate(action, alphazero_output.policy_[rotated_id], alphazero_output.policy_logits_[rotated_id]));
     }
     sort(action_candidates.begin(), action_candidates.end(), [](const MCTS::ActionCandidate& lhs, const MCTS::ActionCandidate& rhs) {
         return lhs.policy_ > rhs.policy_;
@@ -228,15 +459,15 @@ std::vector<MCTS::ActionCandidate> ZeroActor::calculateAlphaZeroActionPolicy(con
     return action_candidates;
 }
 
-std::vector<MCTS::ActionCandidate> ZeroActor::calculateMuZeroActionPolicy(MCTSNode* leaf_node, const std::shared_ptr<network::MuZeroNetworkOutput>& muzero_output)
+std::vector<MCTS::ActionCandidate> ZeroActor::calculateMuZeroActionPolicy(MCTSNode* leaf_node, const network::MuZeroNetworkOutput& muzero_output)
 {
     assert(muzero_network_);
     std::vector<MCTS::ActionCandidate> action_candidates;
     env::Player turn = leaf_node->getAction().nextPlayer();
-    for (size_t action_id = 0; action_id < muzero_output->policy_.size(); ++action_id) {
+    for (int action_id = 0; action_id < muzero_output.policy_size_; ++action_id) {
         const Action action(action_id, turn);
         if (leaf_node == getMCTS()->getRootNode() && !env_.isLegalAction(action)) { continue; }
-        action_candidates.push_back(MCTS::ActionCandidate(action, muzero_output->policy_[action_id], muzero_output->policy_logits_[action_id]));
+        action_candidates.push_back(MCTS::ActionCandidate(action, muzero_output.policy_[action_id], muzero_output.policy_logits_[action_id]));
     }
     sort(action_candidates.begin(), action_candidates.end(), [](const MCTS::ActionCandidate& lhs, const MCTS::ActionCandidate& rhs) {
         return lhs.policy_ > rhs.policy_;
@@ -244,11 +475,28 @@ std::vector<MCTS::ActionCandidate> ZeroActor::calculateMuZeroActionPolicy(MCTSNo
     return action_candidates;
 }
 
-Environment ZeroActor::getEnvironmentTransition(const std::vector<MCTSNode*>& node_path)
+const Environment& ZeroActor::getEnvironmentTransition(int query_index, const std::vector<MCTSNode*>& node_path)
+{
+    // each leaf query keeps its environment until the evaluation returns; the slots are reused across batches to recycle their memory
+    std::vector<Environment>& env_transitions = mcts_search_data_.env_transitions_;
+    assert(query_index >= 0 && query_index <= static_cast<int>(env_transitions.size()));
+    if (query_index == static_cast<int>(env_transitions.size())) {
+        env_transitions.push_back(env_);
+    } else {
+        env_transitions[query_index] = env_;
+    }
+    Environment& env_transition = env_transitions[query_index];
+    for (size_t i = 1; i < node_path.size(); ++i) { env_transition.act(node_path[i]->getAction()); }
+    return env_transition;
+}
+
+uint64_t ZeroActor::getEvaluationCacheKey(const Environment& env_transition, utils::Rotation rotation) const
 {
-    Environment env = env_;
-    for (size_t i = 1; i < node_path.size(); ++i) { env.act(node_path[i]->getAction()); }
-    return env;
+    // the network output depends on the feature rotation, so each rotation of a position has its own entry
+    uint64_t key = env_transition.getFeatureHashKey();
+    if (key == 0) { return 0; }
+    key ^= (static_cast<uint64_t>(rotation) + 1) * 0x9E3779B97F4A7C15ULL;
+    return (key == 0 ? 1 : key);
 }
 
 } // namespace minizero::actor
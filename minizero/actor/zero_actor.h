@@ -5,6 +5,8 @@
 #include "gumbel_zero.h"
 #include "mcts.h"
 #include "muzero_network.h"
+#include "time_system.h"
+#include "transposition_table.h"
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -13,34 +15,54 @@
 
 namespace minizero::actor {
 
+class MCTSLeafQuery {
+public:
+    int batch_id_;
+    int evaluation_cache_generation_;
+    utils::Rotation rotation_;
+    std::vector<MCTSNode*> node_path_;
+};
+
+class MCTSTranspositionData {
+public:
+    float value_;
+    std::vector<MCTS::ActionCandidate> action_candidates_;
+};
+
 class MCTSSearchData {
 public:
     std::string search_info_;
     MCTSNode* selected_node_;
     std::vector<MCTSNode*> node_path_;
+    std::vector<MCTSLeafQuery> leaf_queries_;
+    std::vector<Environment> env_transitions_;
     void clear();
 };
 
 class ZeroActor : public BaseActor {
 public:
     ZeroActor(uint64_t tree_node_size)
-        : tree_node_size_(tree_node_size)
+        : tree_node_size_(tree_node_size),
+          transposition_table_(config::actor_mcts_transposition_table_size)
     {
         alphazero_network_ = nullptr;
         muzero_network_ = nullptr;
+        is_thinking_in_parallel_ = false;
     }
 
     void reset() override;
     void resetSearch() override;
     Action think(bool with_play = false, bool display_board = false) override;
-    void beforeNNEvaluation() override;
-    void afterNNEvaluation(const std::shared_ptr<network::NetworkOutput>& network_output) override;
-    bool isSearchDone() const override { return getMCTS()->reachMaximumSimulation(); }
+    void beforeNNEvaluation() override { selectLeaves(config::actor_mcts_selfplay_batch_size); }
+    void afterNNEvaluation(const std::shared_ptr<network::NetworkOutputBatch>& network_output_batch) override;
+    bool isSearchDone() const override { return getMCTS()->reachMaximumSimulation() || (isSolverEnabled() && getMCTS()->getRootNode()->isSolved()); }
+    bool isRecurrentInference() const override { return muzero_network_ && getMCTS()->getNumSimulation() > 0; }
     Action getSearchAction() const override { return mcts_search_data_.selected_node_->getAction(); }
     bool isResign() const override { return enable_resign_ && getMCTS()->isResign(mcts_search_data_.selected_node_); }
     std::string getSearchInfo() const override { return mcts_search_data_.search_info_; }
     void setNetwork(const std::shared_ptr<network::Network>& network) override;
-    std::shared_ptr<Search> createSearch() override { return std::make_shared<MCTS>(tree_node_size_); }
+    void setThinkNetworks(const std::vector<std::shared_ptr<network::Network>>& networks);
+    std::shared_ptr<Search> createSearch() override { return std::make_shared<MCTS>(tree_node_size_ * (config::actor_mcts_tree_reuse ? 2 : 1)); }
     std::shared_ptr<MCTS> getMCTS() { return std::static_pointer_cast<MCTS>(search_); }
     const std::shared_ptr<MCTS> getMCTS() const { return std::static_pointer_cast<MCTS>(search_); }
 
@@ -50,23 +72,40 @@ protected:
     std::string getMCTSValue() const override { return std::to_string(getMCTS()->getRootNode()->getMean()); }
     std::string getEnvReward() const override;
 
+    // the solver assumes two players alternating moves, so it is disabled in single-player games
+    inline bool isSolverEnabled() const { return config::actor_mcts_solver && env_.getNumPlayer() == 2; }
     virtual void step();
+    virtual void thinkInParallel(const boost::posix_time::ptime& start_ptime);
+    virtual bool isThinkTimeUp(const boost::posix_time::ptime& start_ptime) const;
+    std::shared_ptr<network::NetworkOutputBatch> forward(bool is_initial_inference);
+    virtual void selectLeaves(int max_batch_size);
+    virtual void beforeLeafEvaluation();
+    virtual void afterLeafEvaluation(const std::shared_ptr<network::NetworkOutputBatch>& network_output_batch, int query_index);
+    virtual bool evaluateLeafBySolver(const Environment& env_transition);
+    virtual bool evaluateLeafByTranspositionTable(const Environment& env_transition);
+    virtual bool evaluateLeafByEvaluationCache(const Environment& env_transition);
     virtual void handleSearchDone();
     virtual MCTSNode* decideActionNode();
     virtual void addNoiseToNodeChildren(MCTSNode* node);
+    virtual MCTSNode* findReusableSubtreeRoot();
     virtual std::vector<MCTSNode*> selection() { return (config::actor_use_gumbel ? gumbel_zero_.selection(getMCTS()) : getMCTS()->select()); }
 
-    std::vector<MCTS::ActionCandidate> calculateAlphaZeroActionPolicy(const Environment& env_transition, const std::shared_ptr<network::AlphaZeroNetworkOutput>& alphazero_output, const utils::Rotation& rotation);
-    std::vector<MCTS::ActionCandidate> calculateMuZeroActionPolicy(MCTSNode* leaf_node, const std::shared_ptr<network::MuZeroNetworkOutput>& muzero_output);
-    virtual Environment getEnvironmentTransition(const std::vector<MCTSNode*>& node_path);
+    std::vector<MCTS::ActionCandidate> calculateAlphaZeroActionPolicy(const Environment& env_transition, const network::AlphaZeroNetworkOutput& alphazero_output, const utils::Rotation& rotation);
+    std::vector<MCTS::ActionCandidate> calculateMuZeroActionPolicy(MCTSNode* leaf_node, const network::MuZeroNetworkOutput& muzero_output);
+    virtual const Environment& getEnvironmentTransition(int query_index, const std::vector<MCTSNode*>& node_path);
+    uint64_t getEvaluationCacheKey(const Environment& env_transition, utils::Rotation rotation) const;
 
     bool enable_resign_;
     GumbelZero gumbel_zero_;
     uint64_t tree_node_size_;
+    std::vector<Action> tree_root_action_history_;
     MCTSSearchData mcts_search_data_;
+    TranspositionTable<MCTSTranspositionData> transposition_table_;
     utils::Rotation feature_rotation_;
     std::shared_ptr<network::AlphaZeroNetwork> alphazero_network_;
     std::shared_ptr<network::MuZeroNetwork> muzero_network_;
+    std::vector<std::shared_ptr<ZeroActor>> think_workers_;
+    bool is_thinking_in_parallel_; // the search is done once by thinkInParallel(), not by each thread
 };
 
 } // namespace minizero::actor
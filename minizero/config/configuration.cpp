@@ -14,9 +14,15 @@ float actor_mcts_puct_base = 19652;
 float actor_mcts_puct_init = 1.25;
 float actor_mcts_reward_discount = 1.0f;
 int actor_mcts_think_batch_size = 1;
+int actor_mcts_selfplay_batch_size = 1;
 float actor_mcts_think_time_limit = 0;
+int actor_mcts_think_num_threads = 1;
 bool actor_mcts_value_rescale = false;
 char actor_mcts_value_flipping_player = 'W';
+bool actor_mcts_tree_reuse = false;
+int actor_mcts_transposition_table_size = 0;
+int actor_mcts_num_expanded_children = 0;
+bool actor_mcts_solver = false;
 bool actor_select_action_by_count = false;
 bool actor_select_action_by_softmax_count = true;
 float actor_select_action_softmax_temperature = 1.0f;
@@ -44,6 +50,11 @@ int zero_replay_buffer = 20;
 float zero_disable_resign_ratio = 0.1;
 int zero_actor_intermediate_sequence_length = 0;
 std::string zero_actor_ignored_command = "reset_actors";
+bool zero_actor_pipelined_evaluation = false;
+int zero_actor_evaluation_cache_size = 0;
+int zero_actor_num_games_per_frame = 0;
+bool zero_actor_compress_frame = false;
+int zero_server_max_frame_size = 268435456; // 256 MB
 bool zero_server_accept_different_model_games = true;
 
 // learner parameters
@@ -62,6 +73,10 @@ float learner_momentum = 0.9;
 float learner_weight_decay = 0.0001;
 float learner_value_loss_scale = 1.0f;
 int learner_num_thread = 8;
+int learner_env_snapshot_interval = 0;
+int learner_max_env_snapshots = 16;
+int learner_prefetch_queue_depth = 0;
+bool learner_use_quantized_features = false;
 
 // network parameters
 std::string nn_file_name = "";
@@ -101,7 +116,13 @@ void setConfiguration(ConfigureLoader& cl)
     cl.addParameter("actor_mcts_reward_discount", actor_mcts_reward_discount, "discount factor for calculating Q values", "Actor");                                           // ref: MZ, Sec. Methods
     cl.addParameter("actor_mcts_value_rescale", actor_mcts_value_rescale, "true for games whose rewards are not bounded in [-1, 1], e.g., Atari games", "Actor");             // ref: MZ
     cl.addParameter("actor_mcts_think_batch_size", actor_mcts_think_batch_size, "the MCTS selection batch size; only works when running console", "Actor");
+    cl.addParameter("actor_mcts_selfplay_batch_size", actor_mcts_selfplay_batch_size, "the number of leaves each actor selects for one network forward in self-play", "Actor");
     cl.addParameter("actor_mcts_think_time_limit", actor_mcts_think_time_limit, "the MCTS time limit in seconds, 0 represents disabling time limit (only uses actor_num_simulation); only works when running console", "Actor");
+    cl.addParameter("actor_mcts_think_num_threads", actor_mcts_think_num_threads, "the number of threads sharing the MCTS tree, each evaluating its own batches with a copy of the network; not supported with Gumbel Zero; only works when running console", "Actor");
+    cl.addParameter("actor_mcts_tree_reuse", actor_mcts_tree_reuse, "true for reusing the subtree of the played action in the next search; not supported with Gumbel Zero", "Actor");
+    cl.addParameter("actor_mcts_transposition_table_size", actor_mcts_transposition_table_size, "the number of evaluations each actor caches by position hash key; 0 to disable; only works for AlphaZero and environments providing hash keys", "Actor");
+    cl.addParameter("actor_mcts_num_expanded_children", actor_mcts_num_expanded_children, "the number of children with the highest policy expanded at non-root nodes; more children are expanded as the node is visited; 0 to expand all children", "Actor");
+    cl.addParameter("actor_mcts_solver", actor_mcts_solver, "true for proving wins, losses, and draws from terminal positions and skipping network evaluations of proven nodes (MCTS-Solver); only works for AlphaZero with values in [-1, 1]; ignored in single-player games", "Actor");
     cl.addParameter("actor_select_action_by_count", actor_select_action_by_count, "true for selecting the action by the maximum MCTS count; should not be true together with actor_select_action_by_softmax_count", "Actor");
     cl.addParameter("actor_select_action_by_softmax_count", actor_select_action_by_softmax_count, "true for selecting the action by the propotion of MCTS count; should not be true together with actor_select_action_by_count", "Actor");
     cl.addParameter("actor_select_action_softmax_temperature", actor_select_action_softmax_temperature, "the softmax temperature when using actor_select_action_by_softmax_count", "Actor");
@@ -129,6 +150,11 @@ void setConfiguration(ConfigureLoader& cl)
     cl.addParameter("zero_disable_resign_ratio", zero_disable_resign_ratio, "the probability to keep playing when the winrate is below actor_resign_threshold", "Zero");                                                       // ref: AZ, Sec. Methods
     cl.addParameter("zero_actor_intermediate_sequence_length", zero_actor_intermediate_sequence_length, "the max sequence length when running self-play; usually 0 (unlimited) for board games, 200 for atari games", "Zero"); // ref: MZ
     cl.addParameter("zero_actor_ignored_command", zero_actor_ignored_command, "the commands to ignore by the actor; format: command1 command2 ...", "Zero");
+    cl.addParameter("zero_actor_pipelined_evaluation", zero_actor_pipelined_evaluation, "true for splitting actors into two groups so that one group runs on CPU while the other group's batch runs on GPU", "Zero");
+    cl.addParameter("zero_actor_evaluation_cache_size", zero_actor_evaluation_cache_size, "the number of network evaluations cached and shared by all actors; cleared when loading a new model; 0 to disable; only works for AlphaZero and environments providing hash keys", "Zero");
+    cl.addParameter("zero_actor_num_games_per_frame", zero_actor_num_games_per_frame, "the number of self-play games sent together in a length-prefixed frame; 0 to send each game as a text line", "Zero");
+    cl.addParameter("zero_actor_compress_frame", zero_actor_compress_frame, "true for compressing the frames of self-play games by gzip; only works when zero_actor_num_games_per_frame > 0", "Zero");
+    cl.addParameter("zero_server_max_frame_size", zero_server_max_frame_size, "the maximum payload size in bytes of a frame received by the server; a worker sending a larger frame is disconnected", "Zero");
     cl.addParameter("zero_server_accept_different_model_games", zero_server_accept_different_model_games, "true for accepting self-play games generated by out-of-date model", "Zero");
 
     // learner parameters
@@ -147,6 +173,10 @@ void setConfiguration(ConfigureLoader& cl)
     cl.addParameter("learner_weight_decay", learner_weight_decay, "hyperparameter for weight decay; usually 0.0001 for sgd, 0 for adam, 0.01 for adamw", "Learner");
     cl.addParameter("learner_value_loss_scale", learner_value_loss_scale, "hyperparameter for scaling of the value loss", "Learner");
     cl.addParameter("learner_num_thread", learner_num_thread, "the number of threads for training", "Learner");
+    cl.addParameter("learner_env_snapshot_interval", learner_env_snapshot_interval, "the move interval to keep environment snapshots of each game in the replay buffer, so that getting features replays from the nearest snapshot; 0 to disable", "Learner");
+    cl.addParameter("learner_max_env_snapshots", learner_max_env_snapshots, "the maximum number of environment snapshots kept for each game; the interval is widened for longer games; 0 for no limit", "Learner");
+    cl.addParameter("learner_prefetch_queue_depth", learner_prefetch_queue_depth, "the number of batches sampled in the background while training; 0 to sample each batch on demand; prefetched batches may miss the latest priority updates of PER", "Learner");
+    cl.addParameter("learner_use_quantized_features", learner_use_quantized_features, "send the input features to the trainer as bytes and convert them to float on the training device; ignored for games whose features are not multiples of 1/255 (atari, linesofaction)", "Learner");
 
     // network parameters
     cl.addParameter("nn_file_name", nn_file_name, "the file name of model weights", "Network");
@@ -16,9 +16,15 @@ extern float actor_mcts_puct_base;
 extern float actor_mcts_puct_init;
 extern float actor_mcts_reward_discount;
 extern int actor_mcts_think_batch_size;
+extern int actor_mcts_selfplay_batch_size;
 extern float actor_mcts_think_time_limit;
+extern int actor_mcts_think_num_threads;
 extern bool actor_mcts_value_rescale;
 extern char actor_mcts_value_flipping_player;
+extern bool actor_mcts_tree_reuse;
+extern int actor_mcts_transposition_table_size;
+extern int actor_mcts_num_expanded_children;
+extern bool actor_mcts_solver;
 extern bool actor_select_action_by_count;
 extern bool actor_select_action_by_softmax_count;
 extern float actor_select_action_softmax_temperature;
@@ -46,6 +52,11 @@ extern int zero_replay_buffer;
 extern float zero_disable_resign_ratio;
 extern int zero_actor_intermediate_sequence_length;
 extern std::string zero_actor_ignored_command;
+extern bool zero_actor_pipelined_evaluation;
+extern int zero_actor_evaluation_cache_size;
+extern int zero_actor_num_games_per_frame;
+extern bool zero_actor_compress_frame;
+extern int zero_server_max_frame_size;
 extern bool zero_server_accept_different_model_games;
 
 // learner parameters
@@ -64,6 +75,10 @@ extern float learner_momentum;
 extern float learner_weight_decay;
 extern float learner_value_loss_scale;
 extern int learner_num_thread;
+extern int learner_env_snapshot_interval;
+extern int learner_max_env_snapshots;
+extern int learner_prefetch_queue_depth;
+extern bool learner_use_quantized_features;
 
 // network parameters
 extern std::string nn_file_name;
@@ -42,29 +42,41 @@ Console::Console()
 
 void Console::initialize()
 {
-    if (!network_) { network_ = createNetwork(config::nn_file_name, 0); }
+    if (!network_) {
+        // the other search threads use their own network copies, spread over the visible GPUs, so that their forwards overlap
+        const int reserved_batch_size = std::max(config::actor_mcts_think_batch_size, 1);
+        network_ = createNetwork(config::nn_file_name, 0, reserved_batch_size);
+        think_networks_.clear();
+        const int num_gpus = std::max(static_cast<int>(torch::cuda::device_count()), 1);
+        for (int i = 1; i < config::actor_mcts_think_num_threads; ++i) { think_networks_.push_back(createNetwork(config::nn_file_name, i % num_gpus, reserved_batch_size)); }
+    }
     if (!actor_) {
         uint64_t tree_node_size = static_cast<uint64_t>(config::actor_num_simulation + 1) * network_->getActionSize();
         actor_ = actor::createActor(tree_node_size, network_);
     }
     actor_->setNetwork(network_);
+    std::static_pointer_cast<actor::ZeroActor>(actor_)->setThinkNetworks(think_networks_);
 
     // forward the network several times to warmup since the first few forwards requires some initialization time
     const int num_warmup_forward = 3;
-    if (network_->getNetworkTypeName() == "alphazero") {
-        std::shared_ptr<network::AlphaZeroNetwork> alphazero_network = std::static_pointer_cast<network::AlphaZeroNetwork>(network_);
-        for (int i = 0; i < num_warmup_forward; ++i) {
-            for (int j = 0; j < config::actor_mcts_think_batch_size; ++j) { alphazero_network->pushBack(actor_->getEnvironment().getFeatures()); }
-            alphazero_network->forward();
-        }
-    } else if (network_->getNetworkTypeName() == "muzero" || network_->getNetworkTypeName() == "muzero_atari") {
-        std::shared_ptr<network::MuZeroNetwork> muzero_network = std::static_pointer_cast<network::MuZeroNetwork>(network_);
-        for (int i = 0; i < num_warmup_forward; ++i) {
-            for (int j = 0; j < config::actor_mcts_think_batch_size; ++j) { muzero_network->pushBackInitialData(actor_->getEnvironment().getFeatures()); }
-            muzero_network->initialInference();
+    std::vector<std::shared_ptr<Network>> networks{network_};
+    networks.insert(networks.end(), think_networks_.begin(), think_networks_.end());
+    for (const auto& network : networks) {
+        if (network->getNetworkTypeName() == "alphazero") {
+            std::shared_ptr<network::AlphaZeroNetwork> alphazero_network = std::static_pointer_cast<network::AlphaZeroNetwork>(network);
+            for (int i = 0; i < num_warmup_forward; ++i) {
+                for (int j = 0; j < config::actor_mcts_think_batch_size; ++j) { alphazero_network->pushBack(actor_->getEnvironment().getFeatures()); }
+                alphazero_network->forward();
+            }
+        } else if (network->getNetworkTypeName() == "muzero" || network->getNetworkTypeName() == "muzero_atari") {
+            std::shared_ptr<network::MuZeroNetwork> muzero_network = std::static_pointer_cast<network::MuZeroNetwork>(network);
+            for (int i = 0; i < num_warmup_forward; ++i) {
+                for (int j = 0; j < config::actor_mcts_think_batch_size; ++j) { muzero_network->pushBackInitialData(actor_->getEnvironment().getFeatures()); }
+                muzero_network->initialInference();
+            }
+        } else {
+            assert(false); // should not be here
         }
-    } else {
-        assert(false); // should not be here
     }
 }
 
@@ -324,21 +336,21 @@ void Console::calculatePolicyValue(std::vector<float>& policy, float& value, uti
     if (network_->getNetworkTypeName() == "alphazero") {
         std::shared_ptr<network::AlphaZeroNetwork> alphazero_network = std::static_pointer_cast<network::AlphaZeroNetwork>(network_);
         int index = alphazero_network->pushBack(actor_->getEnvironment().getFeatures(rotation));
-        std::shared_ptr<NetworkOutput> network_output = alphazero_network->forward()[index];
-        std::shared_ptr<minizero::network::AlphaZeroNetworkOutput> zero_output = std::static_pointer_cast<minizero::network::AlphaZeroNetworkOutput>(network_output);
-        value = zero_output->value_;
+        std::shared_ptr<NetworkOutputBatch> network_output_batch = alphazero_network->forward();
+        minizero::network::AlphaZeroNetworkOutput zero_output = std::static_pointer_cast<minizero::network::AlphaZeroNetworkOutputBatch>(network_output_batch)->getOutput(index);
+        value = zero_output.value_;
         policy.clear();
-        for (size_t action_id = 0; action_id < zero_output->policy_.size(); ++action_id) {
+        for (int action_id = 0; action_id < zero_output.policy_size_; ++action_id) {
             int rotated_id = actor_->getEnvironment().getRotateAction(action_id, rotation);
-            policy.push_back(zero_output->policy_[rotated_id]);
+            policy.push_back(zero_output.policy_[rotated_id]);
         }
     } else if (network_->getNetworkTypeName() == "muzero" || network_->getNetworkTypeName() == "muzero_atari") {
         std::shared_ptr<network::MuZeroNetwork> muzero_network = std::static_pointer_cast<network::MuZeroNetwork>(network_);
         int index = muzero_network->pushBackInitialData(actor_->getEnvironment().getFeatures());
-        std::shared_ptr<NetworkOutput> network_output = muzero_network->initialInference()[index];
-        std::shared_ptr<minizero::network::MuZeroNetworkOutput> zero_output = std::static_pointer_cast<minizero::network::MuZeroNetworkOutput>(network_output);
-        policy = zero_output->policy_;
-        value = zero_output->value_;
+        std::shared_ptr<NetworkOutputBatch> network_output_batch = muzero_network->initialInference();
+        minizero::network::MuZeroNetworkOutput zero_output = std::static_pointer_cast<minizero::network::MuZeroNetworkOutputBatch>(network_output_batch)->getOutput(index);
+        policy.assign(zero_output.policy_, zero_output.policy_ + zero_output.policy_size_);
+        value = zero_output.value_;
     } else {
         assert(false); // should not be here
     }
@@ -72,6 +72,7 @@ protected:
 
     std::string command_id_;
     std::shared_ptr<minizero::network::Network> network_;
+    std::vector<std::shared_ptr<minizero::network::Network>> think_networks_;
     std::shared_ptr<actor::BaseActor> actor_;
     std::map<std::string, std::shared_ptr<BaseFunction>> function_map_;
 };
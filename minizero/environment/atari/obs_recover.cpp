@@ -152,7 +152,7 @@ void ObsRecoverSlaveThread::handleEndPosition(std::string& sgf, EnvInfo* env_inf
 
     std::string observation;
     for (const auto& obs : env_info_ptr->env_.getObservationHistory()) { observation += obs; }
-    sgf.replace(begin, end - begin + 1, "OBS[" + utils::compressString(observation) + "]");
+    sgf.replace(begin, end - begin + 1, "OBS[" + utils::compressString(observation, 3 * kAtariResolution * kAtariResolution) + "]");
 
     if (sgf.find("#") != std::string::npos) { getSharedData()->addEnvInfoToRemove(env_info_ptr); }
 }
@@ -7,6 +7,7 @@
 #include "vector_map.h"
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <fstream>
 #include <memory>
 #include <sstream>
@@ -86,6 +87,12 @@ public:
     virtual float getEvalScore(bool is_resign = false) const = 0;
     virtual std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const = 0;
     virtual std::vector<float> getActionFeatures(const Action& action, utils::Rotation rotation = utils::Rotation::kRotationNone) const = 0;
+    virtual void fillFeatures(float* features, utils::Rotation rotation = utils::Rotation::kRotationNone) const
+    {
+        // environments with a faster encoder should override this to write the features in place
+        std::vector<float> env_features = getFeatures(rotation);
+        std::copy(env_features.begin(), env_features.end(), features);
+    }
     virtual int getNumInputChannels() const = 0;
     virtual int getNumActionFeatureChannels() const = 0;
     virtual int getInputChannelHeight() const = 0;
@@ -100,6 +107,7 @@ public:
     virtual std::string name() const = 0;
     virtual int getNumPlayer() const = 0;
     virtual void setTurn(Player p) { turn_ = p; }
+    virtual uint64_t getFeatureHashKey() const { return 0; } // hash of everything getFeatures() depends on; 0 if not supported
 
     inline Player getTurn() const { return turn_; }
     inline const std::vector<Action>& getActionHistory() const { return actions_; }
@@ -128,6 +136,11 @@ public:
         tags_.insert({"GM", name()});
         tags_.insert({"RE", "0"});
         action_pairs_.clear();
+        policy_offsets_.assign(1, 0);
+        policy_entries_.clear();
+        values_.clear();
+        rewards_.clear();
+        env_snapshots_.clear();
     }
 
     virtual bool loadFromFile(const std::string& file_name)
@@ -199,6 +212,7 @@ public:
                     break;
             }
         }
+        buildTrainingRecord();
         return state == ')';
     }
 
@@ -210,11 +224,22 @@ public:
         }
         addTag("RE", std::to_string(env.getEvalScore()));
 
-        // add observations
+        // add observations, consecutive observations are delta encoded since they are mostly the same
         std::string observations;
         for (const auto& obs : env.getObservationHistory()) { observations += obs; }
-        addTag("OBS", utils::compressString(observations));
-        assert(observations == utils::decompressString(getTag("OBS")));
+        addTag("OBS", utils::compressString(observations, env.getObservationHistory().empty() ? 0 : env.getObservationHistory()[0].size()));
+        buildTrainingRecord();
+    }
+
+    // drop the action info already kept in the training record, the record then becomes the only copy of the policy, value, and reward
+    // the SGF exported by toString() no longer contains them, so only call this for loaders used for training
+    virtual void compactActionInfo()
+    {
+        for (auto& action_pair : action_pairs_) {
+            for (const char* key : {"P", "V", "R"}) { action_pair.second.erase(key); }
+        }
+        sgf_content_.clear();
+        sgf_content_.shrink_to_fit();
     }
 
     virtual std::string toString() const
@@ -230,33 +255,32 @@ public:
         return oss.str();
     }
 
+    // keep a copy of the environment every interval moves so that getting features replays at most interval - 1 moves; 0 to disable
+    // a snapshot copies the whole environment including its history, so the interval of long games is widened to keep at most max_num_snapshots copies
+    virtual void buildEnvSnapshots(int interval, int max_num_snapshots)
+    {
+        env_snapshots_.clear();
+        if (interval > 0 && max_num_snapshots > 0) { interval = std::max(interval, static_cast<int>(action_pairs_.size() + max_num_snapshots) / max_num_snapshots); }
+        snapshot_interval_ = interval;
+        if (interval <= 0) { return; }
+
+        Env env = createInitialEnv();
+        for (size_t i = 0; i <= action_pairs_.size(); ++i) {
+            if (i % interval == 0) { env_snapshots_.push_back(std::make_shared<const Env>(env)); }
+            if (i < action_pairs_.size()) { env.act(action_pairs_[i].first); }
+        }
+    }
+
     virtual std::vector<float> getFeatures(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const
     {
-        // a slow but naive method which simply replays the game again to get features
-        Env env;
-        for (int i = 0; i < std::min(pos, static_cast<int>(action_pairs_.size())); ++i) { env.act(action_pairs_[i].first); }
-        return env.getFeatures(rotation);
+        return replayEnvironment(pos).getFeatures(rotation);
     }
 
     virtual std::vector<float> getPolicy(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const
     {
         std::vector<float> policy(getPolicySize(), 0.0f);
-        if (pos < static_cast<int>(action_pairs_.size())) {
-            const std::string policy_distribution = action_pairs_[pos].second["P"];
-            if (policy_distribution.empty()) {
-                policy[getRotateAction(action_pairs_[pos].first.getActionID(), rotation)] = 1.0f;
-            } else {
-                std::string tmp;
-                float total = 0.0f;
-                std::istringstream iss(policy_distribution);
-                while (std::getline(iss, tmp, ',')) {
-                    int position = getRotateAction(std::stoi(tmp.substr(0, tmp.find(":"))), rotation);
-                    float count = std::stof(tmp.substr(tmp.find(":") + 1));
-                    policy[position] = count;
-                    total += count;
-                }
-                for (auto& p : policy) { p /= total; }
-            }
+        if (pos < static_cast<int>(values_.size())) {
+            for (int i = policy_offsets_[pos]; i < policy_offsets_[pos + 1]; ++i) { policy[getRotateAction(policy_entries_[i].first, rotation)] = policy_entries_[i].second; }
         } else { // absorbing states
             std::fill(policy.begin(), policy.end(), 1.0f / getPolicySize());
         }
@@ -273,12 +297,21 @@ public:
         }
     }
 
-    virtual std::vector<float> getValue(const int pos) const { return (pos < static_cast<int>(action_pairs_.size()) ? std::vector<float>{std::stof(action_pairs_[pos].second["V"])} : std::vector<float>{0.0f}); }
-    virtual std::vector<float> getReward(const int pos) const { return (pos < static_cast<int>(action_pairs_.size()) ? std::vector<float>{std::stof(action_pairs_[pos].second["R"])} : std::vector<float>{0.0f}); }
+    virtual std::vector<float> getValue(const int pos) const { return {pos < static_cast<int>(values_.size()) ? values_[pos] : 0.0f}; }
+    virtual std::vector<float> getReward(const int pos) const { return {pos < static_cast<int>(rewards_.size()) ? rewards_[pos] : 0.0f}; }
     virtual bool setActionPairInfo(const int pos, const std::string& tag, const std::string value)
     {
         if (pos >= static_cast<int>(action_pairs_.size())) { return false; }
         action_pairs_[pos].second[tag] = value;
+        if (tag == "V" && pos < static_cast<int>(values_.size())) { values_[pos] = parseFloat(value); }
+        if (tag == "R" && pos < static_cast<int>(rewards_.size())) { rewards_[pos] = parseFloat(value); }
+        return true;
+    }
+    virtual bool setValue(const int pos, float value)
+    {
+        if (pos >= static_cast<int>(values_.size())) { return false; }
+        values_[pos] = value;
+        if (action_pairs_[pos].second.count("V")) { action_pairs_[pos].second["V"] = std::to_string(value); }
         return true;
     }
     virtual float getPriority(const int pos) const { return 1.0f; }
@@ -298,6 +331,51 @@ public:
     inline float getReturn() const { return std::stof(getTag("RE")); }
 
 protected:
+    virtual Env createInitialEnv() const { return Env(); }
+
+    // the environment after the first num_moves moves, replayed from the nearest snapshot if there is any
+    Env replayEnvironment(int num_moves) const
+    {
+        num_moves = std::min(num_moves, static_cast<int>(action_pairs_.size()));
+        int snapshot_index = (env_snapshots_.empty() ? -1 : std::min(num_moves / snapshot_interval_, static_cast<int>(env_snapshots_.size()) - 1));
+        Env env = (snapshot_index == -1 ? createInitialEnv() : *env_snapshots_[snapshot_index]);
+        for (int i = std::max(0, snapshot_index * snapshot_interval_); i < num_moves; ++i) { env.act(action_pairs_[i].first); }
+        return env;
+    }
+
+    // parse the policy, value, and reward of each position once so that sampling training data does not touch strings
+    void buildTrainingRecord()
+    {
+        policy_offsets_.assign(1, 0);
+        policy_entries_.clear();
+        values_.clear();
+        rewards_.clear();
+        for (const auto& action_pair : action_pairs_) {
+            const ActionInfo& action_info = action_pair.second;
+            const std::string& policy_distribution = action_info["P"];
+            size_t policy_begin = policy_entries_.size();
+            if (policy_distribution.empty()) {
+                policy_entries_.emplace_back(action_pair.first.getActionID(), 1.0f);
+            } else {
+                float total = 0.0f;
+                for (size_t begin = 0; begin < policy_distribution.size();) {
+                    size_t end = std::min(policy_distribution.find(',', begin), policy_distribution.size());
+                    size_t colon = policy_distribution.find(':', begin);
+                    float count = std::stof(policy_distribution.substr(colon + 1, end - colon - 1));
+                    policy_entries_.emplace_back(std::stoi(policy_distribution.substr(begin, colon - begin)), count);
+                    total += count;
+                    begin = end + 1;
+                }
+                for (size_t i = policy_begin; i < policy_entries_.size(); ++i) { policy_entries_[i].second /= total; }
+            }
+            policy_offsets_.push_back(policy_entries_.size());
+            values_.push_back(parseFloat(action_info["V"]));
+            rewards_.push_back(parseFloat(action_info["R"]));
+        }
+    }
+
+    inline float parseFloat(const std::string& value) const { return (value.empty() ? 0.0f : std::stof(value)); }
+
     std::string escapeSGFString(const std::string& str) const
     {
         std::string special = "()[]\\";
@@ -314,6 +392,16 @@ protected:
     std::string sgf_content_;
     Tags tags_;
     std::vector<std::pair<Action, ActionInfo>> action_pairs_;
+
+    // training record; the sparse policy of position i is policy_entries_[policy_offsets_[i], policy_offsets_[i + 1])
+    std::vector<int> policy_offsets_;
+    std::vector<std::pair<int, float>> policy_entries_;
+    std::vector<float> values_;
+    std::vector<float> rewards_;
+
+    // env_snapshots_[i] is the environment after i * snapshot_interval_ moves; shared by copies of the loader
+    int snapshot_interval_ = 0;
+    std::vector<std::shared_ptr<const Env>> env_snapshots_;
 };
 
 template <int kNumPlayer = 2>
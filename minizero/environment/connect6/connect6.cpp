@@ -140,6 +140,7 @@ std::vector<float> Connect6Env::getFeatures(utils::Rotation rotation /*= utils::
     int past_moves = std::min(8, static_cast<int>(bitboard_history_.size()));
     int spatial = board_size_ * board_size_;
     std::vector<float> features(getNumInputChannels() * spatial, 0.f);
+    const std::vector<int>& rotate_positions = utils::getRotatePositions(utils::reversed_rotation[static_cast<int>(rotation)], board_size_);
     int last_idx = bitboard_history_.size() - 1;
 
     // 0 ~ 15
@@ -147,7 +148,7 @@ std::vector<float> Connect6Env::getFeatures(utils::Rotation rotation /*= utils::
         const Connect6Bitboard& own_bitboard = bitboard_history_[last_idx - (c / 2)].get(turn_);
         const Connect6Bitboard& opponent_bitboard = bitboard_history_[last_idx - (c / 2)].get(getNextPlayer(turn_, kConnect6NumPlayer));
         for (int pos = 0; pos < spatial; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
+            int rotation_pos = rotate_positions[pos];
             features[pos + c * spatial] = (own_bitboard.test(rotation_pos) ? 1.0f : 0.0f);
             features[pos + (c + 1) * spatial] = (opponent_bitboard.test(rotation_pos) ? 1.0f : 0.0f);
         }
@@ -160,7 +161,7 @@ std::vector<float> Connect6Env::getFeatures(utils::Rotation rotation /*= utils::
     Connect6Bitboard space4 = scanThreadSpace(getNextPlayer(turn_, kConnect6NumPlayer), 4);
 
     for (int pos = 0; pos < spatial; ++pos) {
-        int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
+        int rotation_pos = rotate_positions[pos];
         features[pos + 16 * spatial] = (space1.test(rotation_pos) ? 1.0f : 0.0f);
         features[pos + 17 * spatial] = (space2.test(rotation_pos) ? 1.0f : 0.0f);
         features[pos + 18 * spatial] = (space3.test(rotation_pos) ? 1.0f : 0.0f);
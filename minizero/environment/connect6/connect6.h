@@ -47,7 +47,7 @@ public:
     std::string toString() const override;
     inline std::string name() const override { return kConnect6Name; }
     inline int getNumPlayer() const override { return kConnect6NumPlayer; }
-    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, getBoardSize()); };
+    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getRotatePositions(rotation, getBoardSize())[position]; };
     inline int getRotateAction(int action_id, utils::Rotation rotation) const override { return getRotatePosition(action_id, rotation); };
 
 private:
@@ -69,7 +69,7 @@ public:
     inline std::vector<float> getValue(const int pos) const { return {getReturn()}; }
     inline std::string name() const override { return kConnect6Name; }
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize(); }
-    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, getBoardSize()); };
+    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getRotatePositions(rotation, getBoardSize())[position]; };
     inline int getRotateAction(int action_id, utils::Rotation rotation) const override { return getRotatePosition(action_id, rotation); };
 };
 
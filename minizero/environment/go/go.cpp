@@ -278,33 +278,44 @@ float GoEnv::getEvalScore(bool is_resign /*= false*/) const
 }
 
 std::vector<float> GoEnv::getFeatures(utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
+{
+    std::vector<float> features(getNumInputChannels() * board_size_ * board_size_);
+    fillFeatures(features.data(), rotation);
+    return features;
+}
+
+void GoEnv::fillFeatures(float* features, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
 {
     /* 18 channels:
         0~15. own/opponent position for last 8 turns
         16. black turn
         17. white turn
     */
-    std::vector<float> features;
-    for (int channel = 0; channel < 18; ++channel) {
-        for (int pos = 0; pos < board_size_ * board_size_; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
-            if (channel < 16) {
-                int last_n_turn = stone_bitboard_history_.size() - 1 - channel / 2;
-                if (last_n_turn < 0) {
-                    features.push_back(0.0f);
-                } else {
-                    const GamePair<GoBitboard>& last_n_trun_stone_bitboard = stone_bitboard_history_[last_n_turn];
-                    Player player = (channel % 2 == 0 ? turn_ : getNextPlayer(turn_, kGoNumPlayer));
-                    features.push_back(last_n_trun_stone_bitboard.get(player).test(rotation_pos) ? 1.0f : 0.0f);
-                }
-            } else if (channel == 16) {
-                features.push_back((turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
-            } else if (channel == 17) {
-                features.push_back((turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
-            }
-        }
+    const int board_area = board_size_ * board_size_;
+    const std::vector<int>& rotate_positions = utils::getRotatePositions(rotation, board_size_);
+    std::fill(features, features + 16 * board_area, 0.0f);
+    for (int channel = 0; channel < 16; ++channel) {
+        int last_n_turn = stone_bitboard_history_.size() - 1 - channel / 2;
+        if (last_n_turn < 0) { break; }
+
+        // only visit the stones, and scatter them to their rotated positions
+        Player player = (channel % 2 == 0 ? turn_ : getNextPlayer(turn_, kGoNumPlayer));
+        const GoBitboard& stone_bitboard = stone_bitboard_history_[last_n_turn].get(player);
+        float* plane = features + channel * board_area;
+        for (int pos = stone_bitboard._Find_first(); pos < board_area; pos = stone_bitboard._Find_next(pos)) { plane[rotate_positions[pos]] = 1.0f; }
     }
-    return features;
+    std::fill(features + 16 * board_area, features + 17 * board_area, (turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
+    std::fill(features + 17 * board_area, features + 18 * board_area, (turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
+}
+
+uint64_t GoEnv::getFeatureHashKey() const
+{
+    // the features depend on the positions of the last 8 turns and the current turn
+    uint64_t key = (turn_ == Player::kPlayer1 ? 0 : turn_hash_key);
+    for (int i = std::max(0, static_cast<int>(hashkey_history_.size()) - 8); i < static_cast<int>(hashkey_history_.size()); ++i) {
+        key = (key << 7 | key >> 57) ^ hashkey_history_[i];
+    }
+    return (key == 0 ? 1 : key);
 }
 
 std::vector<float> GoEnv::getActionFeatures(const GoAction& action, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
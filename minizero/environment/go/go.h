@@ -51,6 +51,8 @@ public:
     float getEvalScore(bool is_resign = false) const override;
     std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     std::vector<float> getActionFeatures(const GoAction& action, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    void fillFeatures(float* features, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    uint64_t getFeatureHashKey() const override;
     inline int getNumInputChannels() const override { return 18; }
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize() + 1; }
     std::string toString() const override;
@@ -73,7 +75,7 @@ public:
     inline const std::vector<GoHashKey>& getHashKeyHistory() const { return hashkey_history_; }
     inline const std::unordered_set<GoHashKey>& getHashTable() const { return hash_table_; }
 
-    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, getBoardSize()); };
+    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getRotatePositions(rotation, getBoardSize())[position]; };
     inline int getRotateAction(int action_id, utils::Rotation rotation) const override { return getRotatePosition(action_id, rotation); };
 
 protected:
@@ -131,7 +133,7 @@ public:
     inline std::vector<float> getValue(const int pos) const { return {getReturn()}; }
     inline std::string name() const override { return kGoName + "_" + std::to_string(getBoardSize()) + "x" + std::to_string(getBoardSize()); }
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize() + 1; }
-    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, getBoardSize()); };
+    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getRotatePositions(rotation, getBoardSize())[position]; };
     inline int getRotateAction(int action_id, utils::Rotation rotation) const override { return getRotatePosition(action_id, rotation); };
 };
 
@@ -79,10 +79,11 @@ std::vector<float> GomokuEnv::getFeatures(utils::Rotation rotation /*= utils::Ro
         2. Black's turn
         3. White's turn
     */
+    const std::vector<int>& rotate_positions = utils::getRotatePositions(utils::reversed_rotation[static_cast<int>(rotation)], board_size_);
     std::vector<float> features;
     for (int channel = 0; channel < 4; ++channel) {
         for (int pos = 0; pos < board_size_ * board_size_; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
+            int rotation_pos = rotate_positions[pos];
             if (channel == 0) {
                 features.push_back((board_[rotation_pos] == turn_ ? 1.0f : 0.0f));
             } else if (channel == 1) {
@@ -38,7 +38,7 @@ public:
     inline std::string name() const override { return kGomokuName + (config::env_gomoku_rule == "outer_open" ? "_oo_" : "_") + std::to_string(getBoardSize()) + "x" + std::to_string(getBoardSize()); }
     inline int getNumPlayer() const override { return kGomokuNumPlayer; }
 
-    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, getBoardSize()); };
+    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getRotatePositions(rotation, getBoardSize())[position]; };
     inline int getRotateAction(int action_id, utils::Rotation rotation) const override { return getRotatePosition(action_id, rotation); };
 
 private:
@@ -57,7 +57,7 @@ public:
     inline std::vector<float> getValue(const int pos) const { return {getReturn()}; }
     inline std::string name() const override { return kGomokuName + (config::env_gomoku_rule == "outer_open" ? "_oo_" : "_") + std::to_string(getBoardSize()) + "x" + std::to_string(getBoardSize()); }
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize(); }
-    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, getBoardSize()); };
+    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getRotatePositions(rotation, getBoardSize())[position]; };
     inline int getRotateAction(int action_id, utils::Rotation rotation) const override { return getRotatePosition(action_id, rotation); };
 };
 
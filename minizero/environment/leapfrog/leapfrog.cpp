@@ -410,20 +410,4 @@ std::vector<float> LeapFrogEnvLoader::getActionFeatures(const int pos, utils::Ro
     return action_features;
 }
 
-std::vector<float> LeapFrogEnvLoader::getValue(const int pos) const
-{
-    if (pos >= static_cast<int>(action_pairs_.size())) { return {0.0f}; }
-    auto it = action_pairs_[pos].second.find("V");
-    if (it == action_pairs_[pos].second.end() || it->second.empty()) { return {0.0f}; }
-    return {std::stof(it->second)};
-}
-
-std::vector<float> LeapFrogEnvLoader::getReward(const int pos) const
-{
-    if (pos >= static_cast<int>(action_pairs_.size())) { return {0.0f}; }
-    auto it = action_pairs_[pos].second.find("R");
-    if (it == action_pairs_[pos].second.end() || it->second.empty()) { return {0.0f}; }
-    return {std::stof(it->second)};
-}
-
 } // namespace minizero::env::leapfrog
\ No newline at end of file
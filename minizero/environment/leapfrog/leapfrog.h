@@ -80,8 +80,6 @@ private:
 class LeapFrogEnvLoader : public BaseBoardEnvLoader<LeapFrogAction, LeapFrogEnv> {
 public:
     std::vector<float> getActionFeatures(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
-    std::vector<float> getValue(const int pos) const override;
-    std::vector<float> getReward(const int pos) const override;
     inline std::string name() const override { return kLeapFrogName; }
     inline int getPolicySize() const override { return kNumDirections * getBoardSize() * getBoardSize(); }
     inline int getRotatePosition(int position, utils::Rotation rotation) const override { return position; };
@@ -187,12 +187,11 @@ std::string RubiksEnv::toString() const
     return oss.str();
 }
 
-std::vector<float> RubiksEnvLoader::getFeatures(const int pos, utils::Rotation rotation /* = utils::Rotation::kRotationNone */) const
+RubiksEnv RubiksEnvLoader::createInitialEnv() const
 {
     RubiksEnv env;
     env.reset(getSeed(), getScramble());
-    for (int i = 0; i < std::min(pos, static_cast<int>(action_pairs_.size())); ++i) { env.act(action_pairs_[i].first); }
-    return env.getFeatures(rotation);
+    return env;
 }
 
 std::vector<float> RubiksEnvLoader::getActionFeatures(const int pos, utils::Rotation rotation /* = utils::Rotation::kRotationNone */) const
@@ -199,13 +199,15 @@ public:
     inline int getSeed() const { return std::stoi(BaseBoardEnvLoader<RubiksAction, RubiksEnv>::getTag("SD")); }
     inline int getScramble() const { return std::stoi(BaseBoardEnvLoader<RubiksAction, RubiksEnv>::getTag("SC")); }
 
-    std::vector<float> getFeatures(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     std::vector<float> getActionFeatures(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     inline std::vector<float> getValue(const int pos) const { return {getReturn()}; }
     inline std::string name() const override { return kRubiksName + std::to_string(getBoardSize()) + "x" + std::to_string(getBoardSize()); }
     inline int getPolicySize() const override { return getBoardSize() / 2 * 12; }
     inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(utils::Rotation::kRotationNone, position, getBoardSize()); }
     inline int getRotateAction(int action_id, utils::Rotation rotation) const override { return getRotatePosition(action_id, utils::Rotation::kRotationNone); }
+
+protected:
+    RubiksEnv createInitialEnv() const override;
 };
 
 } // namespace minizero::env::rubiks
@@ -28,7 +28,7 @@ const int kPuzzle2048RotatedActionIndex[8][4] = {
     {0, 3, 2, 1}, // Rotation::kHorizontalRotation180
     {1, 0, 3, 2}, // Rotation::kHorizontalRotation270
 };
-static inline int transformPosition(int pos) { return pos ^ 12; } // used with getPositionByRotating, only for board size 4
+static inline int transformPosition(int pos) { return pos ^ 12; } // used with getRotatePositions, only for board size 4
 
 class Puzzle2048Action : public BaseAction {
 public:
@@ -101,7 +101,7 @@ public:
 
     int getRotatePosition(int position, utils::Rotation rotation) const override
     {
-        return transformPosition(utils::getPositionByRotating(rotation, transformPosition(position), kPuzzle2048BoardSize));
+        return transformPosition(utils::getRotatePositions(rotation, kPuzzle2048BoardSize)[transformPosition(position)]);
     }
     int getRotateAction(int action_id, utils::Rotation rotation) const override
     {
@@ -267,9 +267,10 @@ int TetrisBlockPuzzleEnv::getRotateHoldingBlockID(int holding_block_id, utils::R
 std::vector<float> TetrisBlockPuzzleEnv::getFeatures(utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
 {
     std::vector<float> features;
+    const std::vector<int>& rotate_positions = utils::getRotatePositions(utils::reversed_rotation[static_cast<int>(rotation)], kTetrisBlockPuzzleBoardSize);
     for (int tile = 0; tile <= 1; ++tile) {
         for (int pos = 0; pos < kTetrisBlockPuzzleBoardSize * kTetrisBlockPuzzleBoardSize; ++pos) {
-            features.push_back(board_.get(getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)])) == tile ? 1.0f : 0.0f);
+            features.push_back(board_.get(rotate_positions[pos]) == tile ? 1.0f : 0.0f);
         }
     }
     std::vector<int> holding_blocks = holding_blocks_;
@@ -350,9 +351,7 @@ std::vector<float> TetrisBlockPuzzleEnvLoader::getChance(const int pos, utils::R
 {
     std::vector<float> chance(getChanceEventSize(), 0.0f);
     if (pos < static_cast<int>(action_pairs_.size())) {
-        TetrisBlockPuzzleEnv env;
-        env.reset(getSeed());
-        for (int i = 0; i <= std::min<int>(pos, action_pairs_.size() - 1); ++i) { env.act(action_pairs_[i].first); }
+        TetrisBlockPuzzleEnv env = replayEnvironment(pos + 1);
         chance[env.getChanceEventHistory().back().getActionID() - env.getPolicySize()] = 1.0f;
     } else { // absorbing states
         std::fill(chance.begin(), chance.end(), 1.0f / getChanceEventSize());
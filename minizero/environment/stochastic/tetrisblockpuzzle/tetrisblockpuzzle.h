@@ -58,7 +58,7 @@ public:
     bool isLegalChanceEvent(const TetrisBlockPuzzleAction& action) const override;
     bool isTerminal() const override;
 
-    int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, kTetrisBlockPuzzleBoardSize); }
+    int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getRotatePositions(rotation, kTetrisBlockPuzzleBoardSize)[position]; }
     int getRotateAction(int action_id, utils::Rotation rotation) const override;
     int getRotateHoldingBlockID(int holding_block_id, utils::Rotation rotation) const;
     std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
@@ -111,7 +111,7 @@ public:
     std::string name() const override { return kTetrisBlockPuzzleName; }
     int getPolicySize() const override { return kTetrisBlockPuzzleActionSize; }
     int getChanceEventSize() const override { return kTetrisChanceEventSize; }
-    int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, kTetrisBlockPuzzleBoardSize); }
+    int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getRotatePositions(rotation, kTetrisBlockPuzzleBoardSize)[position]; }
     int getRotateAction(int action_id, utils::Rotation rotation) const override { return TetrisBlockPuzzleEnv().getRotateAction(action_id, rotation); }
     int getRotateChanceEvent(int event_id, utils::Rotation rotation) const override { return event_id; }
 
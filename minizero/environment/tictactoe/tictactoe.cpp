@@ -71,10 +71,11 @@ std::vector<float> TicTacToeEnv::getFeatures(utils::Rotation rotation /*= utils:
         2. Nought turn
         3. Cross turn
     */
+    const std::vector<int>& rotate_positions = utils::getRotatePositions(utils::reversed_rotation[static_cast<int>(rotation)], kTicTacToeBoardSize);
     std::vector<float> features;
     for (int channel = 0; channel < 4; ++channel) {
         for (int pos = 0; pos < kTicTacToeBoardSize * kTicTacToeBoardSize; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
+            int rotation_pos = rotate_positions[pos];
             if (channel == 0) {
                 features.push_back((board_[rotation_pos] == turn_ ? 1.0f : 0.0f));
             } else if (channel == 1) {
@@ -31,7 +31,7 @@ public:
     std::string toString() const override;
     inline std::string name() const override { return kTicTacToeName; }
     inline int getNumPlayer() const override { return kTicTacToeNumPlayer; }
-    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, getBoardSize()); };
+    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getRotatePositions(rotation, getBoardSize())[position]; };
     inline int getRotateAction(int action_id, utils::Rotation rotation) const override { return getRotatePosition(action_id, rotation); };
 
 private:
@@ -46,7 +46,7 @@ public:
     inline std::vector<float> getValue(const int pos) const { return {getReturn()}; }
     inline std::string name() const override { return kTicTacToeName; }
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize(); }
-    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, getBoardSize()); };
+    inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getRotatePositions(rotation, getBoardSize())[position]; };
     inline int getRotateAction(int action_id, utils::Rotation rotation) const override { return getRotatePosition(action_id, rotation); };
 };
 
@@ -4,7 +4,11 @@
 #include "random.h"
 #include "rotation.h"
 #include <algorithm>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <cmath>
 #include <fstream>
+#include <stdexcept>
 #include <utility>
 
 namespace minizero::learner {
@@ -15,8 +19,8 @@ using namespace minizero::utils;
 ReplayBuffer::ReplayBuffer()
 {
     num_data_ = 0;
-    game_priority_sum_ = 0.0f;
-    game_priorities_.clear();
+    first_game_slot_ = 0;
+    game_priorities_.resize(0);
     position_priorities_.clear();
     env_loaders_.clear();
 }
@@ -24,43 +28,56 @@ ReplayBuffer::ReplayBuffer()
 void ReplayBuffer::addData(const EnvironmentLoader& env_loader)
 {
     std::pair<int, int> data_range = env_loader.getDataRange();
-    std::deque<float> position_priorities(data_range.second + 1, 0.0f);
-    float game_priority = 0.0f;
+    std::vector<float> position_priorities(data_range.second + 1, 0.0f);
     for (int i = data_range.first; i <= data_range.second; ++i) {
         position_priorities[i] = std::pow((config::learner_use_per ? env_loader.getPriority(i) : 1.0f), config::learner_per_alpha);
-        game_priority += position_priorities[i];
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
 
     // add new data to replay buffer
     num_data_ += (data_range.second - data_range.first + 1);
-    position_priorities_.push_back(position_priorities);
-    game_priorities_.push_back(game_priority);
+    position_priorities_.emplace_back(position_priorities);
     env_loaders_.push_back(env_loader);
 
-    // remove old data if replay buffer is full
+    // remove old data if replay buffer is full; the game priorities are kept in a circular buffer with one slot per game
     const size_t replay_buffer_max_size = config::zero_replay_buffer * config::zero_num_games_per_iteration;
+    bool rebuild = (game_priorities_.size() != static_cast<int>(replay_buffer_max_size));
     while (position_priorities_.size() > replay_buffer_max_size) {
         data_range = env_loaders_.front().getDataRange();
         num_data_ -= (data_range.second - data_range.first + 1);
+        if (!rebuild) {
+            game_priorities_.set(first_game_slot_, 0.0f);
+            first_game_slot_ = (first_game_slot_ + 1) % game_priorities_.size();
+        }
         position_priorities_.pop_front();
-        game_priorities_.pop_front();
         env_loaders_.pop_front();
     }
+    if (rebuild) {
+        game_priorities_.resize(replay_buffer_max_size);
+        first_game_slot_ = 0;
+        for (size_t env_id = 0; env_id < position_priorities_.size(); ++env_id) { game_priorities_.set(env_id, position_priorities_[env_id].getTotal()); }
+    } else {
+        game_priorities_.set(getGameSlot(env_loaders_.size() - 1), position_priorities_.back().getTotal());
+    }
 }
 
 std::pair<int, int> ReplayBuffer::sampleEnvAndPos()
 {
-    int env_id = sampleIndex(game_priorities_);
-    int pos_id = sampleIndex(position_priorities_[env_id]);
+    // read-only, so multiple threads can sample at the same time
+    int game_slot = game_priorities_.sample(Random::randReal(game_priorities_.getTotal()));
+    int env_id = (game_slot - first_game_slot_ + game_priorities_.size()) % game_priorities_.size();
+    const utils::SumTree& position_priorities = position_priorities_[env_id];
+    int pos_id = position_priorities.sample(Random::randReal(position_priorities.getTotal()));
     return {env_id, pos_id};
 }
 
-int ReplayBuffer::sampleIndex(const std::deque<float>& weight)
+void ReplayBuffer::updatePriority(int env_id, int pos_id, float priority)
 {
-    std::discrete_distribution<> dis(weight.begin(), weight.end());
-    return dis(Random::generator_);
+    // the position priorities of a game are updated by a single thread, while the game priorities are shared
+    position_priorities_[env_id].set(pos_id, priority);
+    std::lock_guard<std::mutex> lock(mutex_);
+    game_priorities_.set(getGameSlot(env_id), position_priorities_[env_id].getTotal());
 }
 
 float ReplayBuffer::getLossScale(const std::pair<int, int>& p)
@@ -69,21 +86,78 @@ float ReplayBuffer::getLossScale(const std::pair<int, int>& p)
 
     // calculate importance sampling ratio
     int env_id = p.first, pos = p.second;
-    float prob = position_priorities_[env_id][pos] / game_priority_sum_;
+    float prob = position_priorities_[env_id].get(pos) / game_priorities_.getTotal();
     return std::pow((num_data_ * prob), (-config::learner_per_init_beta));
 }
 
+void BatchData::resize(const BatchData& size)
+{
+    features_.resize(size.features_.size());
+    quantized_features_.resize(size.quantized_features_.size());
+    action_features_.resize(size.action_features_.size());
+    policy_.resize(size.policy_.size());
+    value_.resize(size.value_.size());
+    reward_.resize(size.reward_.size());
+    loss_scale_.resize(size.loss_scale_.size());
+    sampled_index_.resize(size.sampled_index_.size());
+}
+
+void BatchData::setDataPtr(BatchDataPtr& data_ptr)
+{
+    data_ptr.features_ = features_.data();
+    data_ptr.quantized_features_ = quantized_features_.data();
+    data_ptr.action_features_ = action_features_.data();
+    data_ptr.policy_ = policy_.data();
+    data_ptr.value_ = value_.data();
+    data_ptr.reward_ = reward_.data();
+    data_ptr.loss_scale_ = loss_scale_.data();
+    data_ptr.sampled_index_ = sampled_index_.data();
+}
+
+void BatchData::copyTo(const BatchDataPtr& data_ptr) const
+{
+    std::copy(features_.begin(), features_.end(), data_ptr.features_);
+    std::copy(quantized_features_.begin(), quantized_features_.end(), data_ptr.quantized_features_);
+    std::copy(action_features_.begin(), action_features_.end(), data_ptr.action_features_);
+    std::copy(policy_.begin(), policy_.end(), data_ptr.policy_);
+    std::copy(value_.begin(), value_.end(), data_ptr.value_);
+    std::copy(reward_.begin(), reward_.end(), data_ptr.reward_);
+    std::copy(loss_scale_.begin(), loss_scale_.end(), data_ptr.loss_scale_);
+    std::copy(sampled_index_.begin(), sampled_index_.end(), data_ptr.sampled_index_);
+}
+
 std::string DataLoaderSharedData::getNextEnvString()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    // wait for the next game while the file is still being read
+    std::unique_lock<std::mutex> lock(mutex_);
+    env_strings_cv_.wait(lock, [this] { return !env_strings_.empty() || !is_reading_file_; });
     std::string env_string = "";
     if (!env_strings_.empty()) {
-        env_string = env_strings_.front();
+        env_string = std::move(env_strings_.front());
         env_strings_.pop_front();
     }
     return env_string;
 }
 
+void DataLoaderSharedData::pushEnvStrings(std::vector<std::string>& env_strings)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& env_string : env_strings) { env_strings_.push_back(std::move(env_string)); }
+    }
+    env_strings.clear();
+    env_strings_cv_.notify_all();
+}
+
+void DataLoaderSharedData::finishReadingFile()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_reading_file_ = false;
+    }
+    env_strings_cv_.notify_all();
+}
+
 int DataLoaderSharedData::getNextBatchIndex()
 {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -98,8 +172,10 @@ void DataLoaderThread::initialize()
 
 void DataLoaderThread::runJob()
 {
-    if (!getSharedData()->env_strings_.empty()) {
+    if (getSharedData()->is_loading_file_) {
         while (addEnvironmentLoader()) {}
+    } else if (getSharedData()->is_updating_priority_) {
+        updatePriority();
     } else {
         while (sampleData()) {}
     }
@@ -111,7 +187,11 @@ bool DataLoaderThread::addEnvironmentLoader()
     if (env_string.empty()) { return false; }
 
     EnvironmentLoader env_loader;
-    if (env_loader.loadFromString(env_string)) { getSharedData()->replay_buffer_.addData(env_loader); }
+    if (env_loader.loadFromString(env_string)) {
+        env_loader.compactActionInfo();
+        env_loader.buildEnvSnapshots(config::learner_env_snapshot_interval, config::learner_max_env_snapshots);
+        getSharedData()->replay_buffer_.addData(env_loader);
+    }
     return true;
 }
 
@@ -131,6 +211,61 @@ bool DataLoaderThread::sampleData()
     return true;
 }
 
+void DataLoaderThread::updatePriority()
+{
+    // each game is updated by one thread, so that the positions sampled several times from a game do not race
+    const int* sampled_index = getSharedData()->priority_sampled_index_;
+    const float* batch_values = getSharedData()->priority_batch_values_;
+    for (int batch_index = 0; batch_index < config::learner_batch_size; ++batch_index) {
+        int env_id = sampled_index[2 * batch_index];
+        int pos_id = sampled_index[2 * batch_index + 1];
+        if (env_id % config::learner_num_thread != id_) { continue; }
+
+        EnvironmentLoader& env_loader = getSharedData()->replay_buffer_.env_loaders_[env_id];
+        for (int step = 0; step <= config::learner_muzero_unrolling_step; ++step) {
+            float new_value = utils::invertValue(batch_values[step * config::learner_batch_size + batch_index]);
+            env_loader.setValue(pos_id + step, new_value);
+        }
+        getSharedData()->replay_buffer_.updatePriority(env_id, pos_id, std::pow(env_loader.getPriority(pos_id), config::learner_per_alpha));
+    }
+}
+
+bool useQuantizedFeatures()
+{
+#if ATARI || LINESOFACTION
+    // the action planes of Atari (id / 18) and the line counts of Lines of Action (n / 8) are not multiples of 1/255
+    return false;
+#else
+    return config::learner_use_quantized_features;
+#endif
+}
+
+static uint8_t quantizeFeature(float feature)
+{
+    return static_cast<uint8_t>(std::min(std::max(feature, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+static bool isQuantizedExactly(float feature)
+{
+    return std::abs(quantizeFeature(feature) / 255.0f - feature) <= 1e-6f;
+}
+
+void DataLoaderThread::setFeatures(int batch_index, const std::vector<float>& features)
+{
+    if (!useQuantizedFeatures()) {
+        std::copy(features.begin(), features.end(), getSharedData()->getDataPtr()->features_ + features.size() * batch_index);
+        return;
+    }
+
+    // the features of the other games are binary planes, so they are sent as bytes and scaled back by the trainer without loss
+    // this runs on a slave thread, so an inexact feature is only recorded here and reported by DataLoader::sampleData()
+    uint8_t* quantized_features = getSharedData()->getDataPtr()->quantized_features_ + features.size() * batch_index;
+    for (size_t i = 0; i < features.size(); ++i) {
+        quantized_features[i] = quantizeFeature(features[i]);
+        if (!isQuantizedExactly(features[i])) { getSharedData()->has_inexact_quantized_feature_ = true; }
+    }
+}
+
 void DataLoaderThread::setAlphaZeroTrainingData(int batch_index)
 {
     // random pickup one position
@@ -149,7 +284,7 @@ void DataLoaderThread::setAlphaZeroTrainingData(int batch_index)
     getSharedData()->getDataPtr()->loss_scale_[batch_index] = loss_scale;
     getSharedData()->getDataPtr()->sampled_index_[2 * batch_index] = p.first;
     getSharedData()->getDataPtr()->sampled_index_[2 * batch_index + 1] = p.second;
-    std::copy(features.begin(), features.end(), getSharedData()->getDataPtr()->features_ + features.size() * batch_index);
+    setFeatures(batch_index, features);
     std::copy(policy.begin(), policy.end(), getSharedData()->getDataPtr()->policy_ + policy.size() * batch_index);
     std::copy(value.begin(), value.end(), getSharedData()->getDataPtr()->value_ + value.size() * batch_index);
 }
@@ -192,7 +327,7 @@ void DataLoaderThread::setMuZeroTrainingData(int batch_index)
     getSharedData()->getDataPtr()->loss_scale_[batch_index] = loss_scale;
     getSharedData()->getDataPtr()->sampled_index_[2 * batch_index] = p.first;
     getSharedData()->getDataPtr()->sampled_index_[2 * batch_index + 1] = p.second;
-    std::copy(features.begin(), features.end(), getSharedData()->getDataPtr()->features_ + features.size() * batch_index);
+    setFeatures(batch_index, features);
     std::copy(action_features.begin(), action_features.end(), getSharedData()->getDataPtr()->action_features_ + action_features.size() * batch_index);
     std::copy(policy.begin(), policy.end(), getSharedData()->getDataPtr()->policy_ + policy.size() * batch_index);
     std::copy(value.begin(), value.end(), getSharedData()->getDataPtr()->value_ + value.size() * batch_index);
@@ -205,51 +340,190 @@ DataLoader::DataLoader(const std::string& conf_file_name)
     config::ConfigureLoader cl;
     config::setConfiguration(cl);
     cl.loadFromFile(conf_file_name);
+    is_replay_buffer_ready_ = false;
 }
 
 void DataLoader::initialize()
 {
     createSlaveThreads(config::learner_num_thread);
     getSharedData()->createDataPtr();
+
+    // check the features of the initial position here, so that an unsupported game fails before any training starts
+    if (useQuantizedFeatures()) {
+        Environment env;
+        env.reset();
+        std::vector<float> features = env.getFeatures();
+        if (!std::all_of(features.begin(), features.end(), isQuantizedExactly)) { throw std::runtime_error{"DataLoader::initialize(): the input features are not multiples of 1/255, disable learner_use_quantized_features"}; }
+    }
+
+    // sample up to learner_prefetch_queue_depth batches in the background while the previous ones are being trained
+    if (config::learner_prefetch_queue_depth > 0) {
+        BatchData size = getBatchDataSize();
+        for (int i = 0; i < config::learner_prefetch_queue_depth; ++i) {
+            free_batches_.push_back(std::make_shared<BatchData>());
+            free_batches_.back()->resize(size);
+        }
+        thread_groups_.create_thread(boost::bind(&DataLoader::runPrefetch, this));
+    }
 }
 
 void DataLoader::loadDataFromFile(const std::string& file_name)
 {
-    std::ifstream fin(file_name, std::ifstream::in);
-    for (std::string content; std::getline(fin, content);) { getSharedData()->env_strings_.push_back(content); }
+    std::lock_guard<std::mutex> lock(replay_buffer_mutex_);
 
+    // stream the games to the slave threads while reading, so that parsing overlaps with reading
+    getSharedData()->is_loading_file_ = true;
+    getSharedData()->is_reading_file_ = true;
     for (auto& t : slave_threads_) { t->start(); }
+    int num_games = readEnvStringsFromFile(file_name);
+    getSharedData()->finishReadingFile();
     for (auto& t : slave_threads_) { t->finish(); }
-    getSharedData()->replay_buffer_.game_priority_sum_ = std::accumulate(getSharedData()->replay_buffer_.game_priorities_.begin(), getSharedData()->replay_buffer_.game_priorities_.end(), 0.0f);
+    getSharedData()->is_loading_file_ = false;
+    if (num_games == 0) { return; }
+
+    // prefetched batches refer to the env ids before loading, so discard them
+    // the prefetch thread needs replay_buffer_mutex_ to sample, so no batch is prefetched while loading
+    {
+        boost::lock_guard<boost::mutex> prefetch_lock(prefetch_mutex_);
+        free_batches_.insert(free_batches_.end(), ready_batches_.begin(), ready_batches_.end());
+        ready_batches_.clear();
+        is_replay_buffer_ready_ = !getSharedData()->replay_buffer_.env_loaders_.empty();
+    }
+    prefetch_cv_.notify_all();
 }
 
-void DataLoader::sampleData()
+int DataLoader::readEnvStringsFromFile(const std::string& file_name)
+{
+    const int chunk_size = 64;
+    int num_games = 0;
+    std::vector<std::string> env_strings;
+    if (file_name.size() >= 3 && file_name.substr(file_name.size() - 3) == ".gz") {
+        // compressed files cannot be resumed from an offset, so they are only loaded once and never tailed
+        if (file_offsets_.count(file_name)) { return 0; }
+        std::ifstream fin(file_name, std::ifstream::in | std::ifstream::binary);
+        if (!fin) { return 0; }
+        file_offsets_[file_name] = 0;
+        boost::iostreams::filtering_istream in;
+        in.push(boost::iostreams::gzip_decompressor());
+        in.push(fin);
+        for (std::string content; std::getline(in, content);) {
+            if (!content.empty()) {
+                env_strings.push_back(std::move(content));
+                ++num_games;
+            }
+            if (static_cast<int>(env_strings.size()) >= chunk_size) { getSharedData()->pushEnvStrings(env_strings); }
+        }
+    } else {
+        // only complete lines are loaded; a game still being written is loaded next time
+        std::ifstream fin(file_name, std::ifstream::in);
+        std::streamoff& offset = file_offsets_[file_name];
+        fin.seekg(offset);
+        for (std::string content; std::getline(fin, content) && !fin.eof();) {
+            offset = fin.tellg();
+            if (!content.empty()) {
+                env_strings.push_back(std::move(content));
+                ++num_games;
+            }
+            if (static_cast<int>(env_strings.size()) >= chunk_size) { getSharedData()->pushEnvStrings(env_strings); }
+        }
+    }
+    getSharedData()->pushEnvStrings(env_strings);
+    return num_games;
+}
+
+void DataLoader::sampleData(const BatchDataPtr& output)
+{
+    if (config::learner_prefetch_queue_depth == 0) {
+        std::lock_guard<std::mutex> lock(replay_buffer_mutex_);
+        if (getSharedData()->replay_buffer_.env_loaders_.empty()) { throw std::runtime_error{"DataLoader::sampleData(): the replay buffer is empty"}; }
+        *getSharedData()->getDataPtr() = output;
+        sampleDataBySlaveThreads();
+        checkQuantizedFeatures();
+        return;
+    }
+
+    std::shared_ptr<BatchData> batch;
+    {
+        boost::unique_lock<boost::mutex> lock(prefetch_mutex_);
+        // batches are only prefetched after some data is loaded, so waiting on an empty replay buffer would never return
+        if (ready_batches_.empty() && !is_replay_buffer_ready_) { throw std::runtime_error{"DataLoader::sampleData(): the replay buffer is empty"}; }
+        prefetch_cv_.wait(lock, [this] { return !ready_batches_.empty(); });
+        batch = ready_batches_.front();
+        ready_batches_.pop_front();
+    }
+    batch->copyTo(output);
+    {
+        boost::lock_guard<boost::mutex> lock(prefetch_mutex_);
+        free_batches_.push_back(batch);
+    }
+    prefetch_cv_.notify_all();
+    checkQuantizedFeatures();
+}
+
+void DataLoader::checkQuantizedFeatures()
+{
+    // thrown on the caller's thread so that it reaches python as a RuntimeError
+    if (getSharedData()->has_inexact_quantized_feature_) { throw std::runtime_error{"DataLoader::sampleData(): the input features are not multiples of 1/255, disable learner_use_quantized_features"}; }
+}
+
+void DataLoader::sampleDataBySlaveThreads()
 {
     getSharedData()->batch_index_ = 0;
     for (auto& t : slave_threads_) { t->start(); }
     for (auto& t : slave_threads_) { t->finish(); }
 }
 
-void DataLoader::updatePriority(int* sampled_index, float* batch_values)
+void DataLoader::runPrefetch()
 {
-    // TODO: use multiple threads
-    for (int batch_index = 0; batch_index < config::learner_batch_size; ++batch_index) {
-        int env_id = sampled_index[2 * batch_index];
-        int pos_id = sampled_index[2 * batch_index + 1];
+    while (true) {
+        std::shared_ptr<BatchData> batch;
+        {
+            boost::unique_lock<boost::mutex> lock(prefetch_mutex_);
+            prefetch_cv_.wait(lock, [this] { return !free_batches_.empty() && is_replay_buffer_ready_; });
+            batch = free_batches_.front();
+            free_batches_.pop_front();
+        }
 
-        EnvironmentLoader& env_loader = getSharedData()->replay_buffer_.env_loaders_[env_id];
-        for (int step = 0; step <= config::learner_muzero_unrolling_step; ++step) {
-            float new_value = utils::invertValue(batch_values[step * config::learner_batch_size + batch_index]);
-            env_loader.setActionPairInfo(pos_id + step, "V", std::to_string(new_value));
+        std::lock_guard<std::mutex> lock(replay_buffer_mutex_);
+        batch->setDataPtr(*getSharedData()->getDataPtr());
+        sampleDataBySlaveThreads();
+        {
+            boost::lock_guard<boost::mutex> prefetch_lock(prefetch_mutex_);
+            ready_batches_.push_back(batch);
         }
-        getSharedData()->replay_buffer_.position_priorities_[env_id][pos_id] = std::pow(env_loader.getPriority(pos_id), config::learner_per_alpha);
+        prefetch_cv_.notify_all();
     }
+}
 
-    // recalculate priority to correct floating number error (TODO: speedup this)
-    for (size_t i = 0; i < getSharedData()->replay_buffer_.game_priorities_.size(); ++i) {
-        getSharedData()->replay_buffer_.game_priorities_[i] = std::accumulate(getSharedData()->replay_buffer_.position_priorities_[i].begin(), getSharedData()->replay_buffer_.position_priorities_[i].end(), 0.0f);
-    }
-    getSharedData()->replay_buffer_.game_priority_sum_ = std::accumulate(getSharedData()->replay_buffer_.game_priorities_.begin(), getSharedData()->replay_buffer_.game_priorities_.end(), 0.0f);
+BatchData DataLoader::getBatchDataSize() const
+{
+    Environment env;
+    const int batch_size = config::learner_batch_size;
+    const int unrolling_step = (config::nn_type_name == "alphazero" ? 0 : config::learner_muzero_unrolling_step);
+    const int hidden_size = env.getHiddenChannelHeight() * env.getHiddenChannelWidth();
+    BatchData size;
+    const int feature_size = batch_size * env.getNumInputChannels() * env.getInputChannelHeight() * env.getInputChannelWidth();
+    size.features_.resize(useQuantizedFeatures() ? 0 : feature_size);
+    size.quantized_features_.resize(useQuantizedFeatures() ? feature_size : 0);
+    size.action_features_.resize(batch_size * unrolling_step * env.getNumActionFeatureChannels() * hidden_size);
+    size.policy_.resize(batch_size * (unrolling_step + 1) * env.getPolicySize());
+    size.value_.resize(batch_size * (unrolling_step + 1) * env.getDiscreteValueSize());
+    size.reward_.resize(batch_size * unrolling_step * env.getDiscreteValueSize());
+    size.loss_scale_.resize(batch_size);
+    size.sampled_index_.resize(2 * batch_size);
+    return size;
+}
+
+void DataLoader::updatePriority(int* sampled_index, float* batch_values)
+{
+    // prefetched batches are sampled with the priorities before this update
+    std::lock_guard<std::mutex> lock(replay_buffer_mutex_);
+    getSharedData()->is_updating_priority_ = true;
+    getSharedData()->priority_sampled_index_ = sampled_index;
+    getSharedData()->priority_batch_values_ = batch_values;
+    for (auto& t : slave_threads_) { t->start(); }
+    for (auto& t : slave_threads_) { t->finish(); }
+    getSharedData()->is_updating_priority_ = false;
 }
 
 } // namespace minizero::learner
@@ -2,15 +2,24 @@
 
 #include "environment.h"
 #include "paralleler.h"
+#include "sum_tree.h"
+#include <atomic>
+#include <boost/thread.hpp>
+#include <condition_variable>
+#include <cstdint>
 #include <deque>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace minizero::learner {
 
+// whether the input features are sent to the trainer as bytes; always false for games whose features are not multiples of 1/255
+bool useQuantizedFeatures();
+
 class BaseBatchDataPtr {
 public:
     BaseBatchDataPtr() {}
@@ -23,6 +32,7 @@ public:
     virtual ~BatchDataPtr() = default;
 
     float* features_;
+    uint8_t* quantized_features_;
     float* action_features_;
     float* policy_;
     float* value_;
@@ -31,34 +41,63 @@ public:
     int* sampled_index_;
 };
 
+// owning buffers of one batch, filled in the background when prefetching is enabled
+class BatchData {
+public:
+    void resize(const BatchData& size);
+    void setDataPtr(BatchDataPtr& data_ptr);
+    void copyTo(const BatchDataPtr& data_ptr) const;
+
+    std::vector<float> features_;
+    std::vector<uint8_t> quantized_features_;
+    std::vector<float> action_features_;
+    std::vector<float> policy_;
+    std::vector<float> value_;
+    std::vector<float> reward_;
+    std::vector<float> loss_scale_;
+    std::vector<int> sampled_index_;
+};
+
 class ReplayBuffer {
 public:
     ReplayBuffer();
 
     std::mutex mutex_;
     int num_data_;
-    float game_priority_sum_;
-    std::deque<float> game_priorities_;
-    std::deque<std::deque<float>> position_priorities_;
+    int first_game_slot_;
+    utils::SumTree game_priorities_; // indexed by game slot in a circular buffer, see getGameSlot()
+    std::deque<utils::SumTree> position_priorities_;
     std::deque<EnvironmentLoader> env_loaders_;
 
     void addData(const EnvironmentLoader& env_loader);
     std::pair<int, int> sampleEnvAndPos();
-    int sampleIndex(const std::deque<float>& weight);
+    void updatePriority(int env_id, int pos_id, float priority);
     float getLossScale(const std::pair<int, int>& p);
+    inline int getGameSlot(int env_id) const { return (first_game_slot_ + env_id) % game_priorities_.size(); }
 };
 
 class DataLoaderSharedData : public utils::BaseSharedData {
 public:
+    DataLoaderSharedData() : is_loading_file_(false), is_reading_file_(false), is_updating_priority_(false), has_inexact_quantized_feature_(false) {}
+
     std::string getNextEnvString();
+    void pushEnvStrings(std::vector<std::string>& env_strings);
+    void finishReadingFile();
     int getNextBatchIndex();
 
     virtual void createDataPtr() { data_ptr_ = std::make_shared<BatchDataPtr>(); }
     inline std::shared_ptr<BatchDataPtr> getDataPtr() { return std::static_pointer_cast<BatchDataPtr>(data_ptr_); }
 
     int batch_index_;
+    bool is_loading_file_;
+    bool is_reading_file_;
+    bool is_updating_priority_;
+    std::atomic<bool> has_inexact_quantized_feature_;
+    int* priority_sampled_index_;
+    float* priority_batch_values_;
     ReplayBuffer replay_buffer_;
     std::mutex mutex_;
+    std::condition_variable env_strings_cv_;
     std::deque<std::string> env_strings_;
     std::shared_ptr<BaseBatchDataPtr> data_ptr_;
 };
@@ -75,7 +114,9 @@ public:
 protected:
     virtual bool addEnvironmentLoader();
     virtual bool sampleData();
+    virtual void updatePriority();
 
+    virtual void setFeatures(int batch_index, const std::vector<float>& features);
     virtual void setAlphaZeroTrainingData(int batch_index);
     virtual void setMuZeroTrainingData(int batch_index);
 
@@ -85,16 +126,42 @@ protected:
 class DataLoader : public utils::BaseParalleler {
 public:
     DataLoader(const std::string& conf_file_name);
+    virtual ~DataLoader()
+    {
+        // stop the prefetch thread before the members it uses are destroyed
+        thread_groups_.interrupt_all();
+        thread_groups_.join_all();
+    }
 
     void initialize() override;
     void summarize() override {}
     virtual void loadDataFromFile(const std::string& file_name);
-    virtual void sampleData();
+    virtual void sampleData(const BatchDataPtr& output);
     virtual void updatePriority(int* sampled_index, float* batch_values);
 
     void createSharedData() override { shared_data_ = std::make_shared<DataLoaderSharedData>(); }
     std::shared_ptr<utils::BaseSlaveThread> newSlaveThread(int id) override { return std::make_shared<DataLoaderThread>(id, shared_data_); }
     inline std::shared_ptr<DataLoaderSharedData> getSharedData() { return std::static_pointer_cast<DataLoaderSharedData>(shared_data_); }
+
+protected:
+    virtual int readEnvStringsFromFile(const std::string& file_name);
+    virtual void sampleDataBySlaveThreads();
+    virtual void checkQuantizedFeatures();
+    virtual void runPrefetch();
+    virtual BatchData getBatchDataSize() const;
+
+    // replay_buffer_mutex_ keeps the replay buffer unchanged while a batch is being sampled
+    // the prefetch thread moves batches from free_batches_ to ready_batches_, sample_data moves them back
+    std::mutex replay_buffer_mutex_;
+    bool is_replay_buffer_ready_;
+    boost::mutex prefetch_mutex_;
+    boost::condition_variable prefetch_cv_;
+    std::deque<std::shared_ptr<BatchData>> free_batches_;
+    std::deque<std::shared_ptr<BatchData>> ready_batches_;
+
+    // the number of bytes already loaded from each file, so that loading a file again only reads the games appended since then
+    // compressed files are only recorded to mark them as loaded
+    std::unordered_map<std::string, std::streamoff> file_offsets_;
 };
 
 } // namespace minizero::learner
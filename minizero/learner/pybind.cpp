@@ -36,6 +36,7 @@ PYBIND11_MODULE(minizero_py, m)
     m.def("use_gumbel", []() { return config::actor_use_gumbel; });
     m.def("get_zero_replay_buffer", []() { return config::zero_replay_buffer; });
     m.def("use_per", []() { return config::learner_use_per; });
+    m.def("use_quantized_features", []() { return learner::useQuantizedFeatures(); });
     m.def("get_training_step", []() { return config::learner_training_step; });
     m.def("get_training_display_step", []() { return config::learner_training_display_step; });
     m.def("get_batch_size", []() { return config::learner_batch_size; });
@@ -70,15 +71,17 @@ PYBIND11_MODULE(minizero_py, m)
             },
             py::call_guard<py::gil_scoped_release>())
         .def(
-            "sample_data", [](learner::DataLoader& data_loader, py::array_t<float>& features, py::array_t<float>& action_features, py::array_t<float>& policy, py::array_t<float>& value, py::array_t<float>& reward, py::array_t<float>& loss_scale, py::array_t<int>& sampled_index) {
-                data_loader.getSharedData()->getDataPtr()->features_ = static_cast<float*>(features.request().ptr);
-                data_loader.getSharedData()->getDataPtr()->action_features_ = static_cast<float*>(action_features.request().ptr);
-                data_loader.getSharedData()->getDataPtr()->policy_ = static_cast<float*>(policy.request().ptr);
-                data_loader.getSharedData()->getDataPtr()->value_ = static_cast<float*>(value.request().ptr);
-                data_loader.getSharedData()->getDataPtr()->reward_ = static_cast<float*>(reward.request().ptr);
-                data_loader.getSharedData()->getDataPtr()->loss_scale_ = static_cast<float*>(loss_scale.request().ptr);
-                data_loader.getSharedData()->getDataPtr()->sampled_index_ = static_cast<int*>(sampled_index.request().ptr);
-                data_loader.sampleData();
+            "sample_data", [](learner::DataLoader& data_loader, py::array& features, py::array_t<float>& action_features, py::array_t<float>& policy, py::array_t<float>& value, py::array_t<float>& reward, py::array_t<float>& loss_scale, py::array_t<int>& sampled_index) {
+                learner::BatchDataPtr output;
+                output.features_ = static_cast<float*>(features.request().ptr);
+                output.quantized_features_ = static_cast<uint8_t*>(features.request().ptr);
+                output.action_features_ = static_cast<float*>(action_features.request().ptr);
+                output.policy_ = static_cast<float*>(policy.request().ptr);
+                output.value_ = static_cast<float*>(value.request().ptr);
+                output.reward_ = static_cast<float*>(reward.request().ptr);
+                output.loss_scale_ = static_cast<float*>(loss_scale.request().ptr);
+                output.sampled_index_ = static_cast<int*>(sampled_index.request().ptr);
+                data_loader.sampleData(output);
             },
             py::call_guard<py::gil_scoped_release>());
 }
@@ -22,7 +22,7 @@ class MinizeroDadaLoader:
 
         # allocate memory
         self.sampled_index = np.zeros(py.get_batch_size() * 2, dtype=np.int32)
-        self.features = np.zeros(py.get_batch_size() * py.get_nn_num_input_channels() * py.get_nn_input_channel_height() * py.get_nn_input_channel_width(), dtype=np.float32)
+        self.features = np.zeros(py.get_batch_size() * py.get_nn_num_input_channels() * py.get_nn_input_channel_height() * py.get_nn_input_channel_width(), dtype=np.uint8 if py.use_quantized_features() else np.float32)
         self.loss_scale = np.zeros(py.get_batch_size(), dtype=np.float32)
         self.value_accumulator = np.ones(1) if py.get_nn_discrete_value_size() == 1 else np.arange(-int(py.get_nn_discrete_value_size() / 2), int(py.get_nn_discrete_value_size() / 2) + 1)
         if py.get_nn_type_name() == "alphazero":
@@ -40,16 +40,20 @@ class MinizeroDadaLoader:
     def load_data(self, training_dir, start_iter, end_iter):
         for i in range(start_iter, end_iter + 1):
             file_name = f"{training_dir}/sgf/{i}.sgf"
+            # files already loaded are loaded again, the loader only reads the games appended since the last call
+            self.data_loader.load_data_from_file(file_name)
             if file_name in self.data_list:
                 continue
-            self.data_loader.load_data_from_file(file_name)
             self.data_list.append(file_name)
             if len(self.data_list) > py.get_zero_replay_buffer():
                 self.data_list.pop(0)
 
     def sample_data(self, device='cpu'):
         self.data_loader.sample_data(self.features, self.action_features, self.policy, self.value, self.reward, self.loss_scale, self.sampled_index)
-        features = torch.FloatTensor(self.features).view(py.get_batch_size(), py.get_nn_num_input_channels(), py.get_nn_input_channel_height(), py.get_nn_input_channel_width()).to(device)
+        if py.use_quantized_features():
+            features = torch.from_numpy(self.features).to(device).float().div_(255).view(py.get_batch_size(), py.get_nn_num_input_channels(), py.get_nn_input_channel_height(), py.get_nn_input_channel_width())
+        else:
+            features = torch.FloatTensor(self.features).view(py.get_batch_size(), py.get_nn_num_input_channels(), py.get_nn_input_channel_height(), py.get_nn_input_channel_width()).to(device)
         action_features = None if self.action_features is None else torch.FloatTensor(self.action_features).view(py.get_batch_size(),
                                                                                                                  -1,
                                                                                                                  py.get_nn_num_action_feature_channels(),
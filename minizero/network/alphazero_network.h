@@ -1,32 +1,67 @@
 #pragma once
 
+#include "evaluation_cache.h"
 #include "network.h"
 #include "utils.h"
 #include <algorithm>
+#include <atomic>
 #include <memory>
-#include <mutex>
 #include <string>
 #include <vector>
 
 namespace minizero::network {
 
-class AlphaZeroNetworkOutput : public NetworkOutput {
+class AlphaZeroNetworkOutput {
 public:
+    float value_;
+    int policy_size_;
+    const float* policy_;
+    const float* policy_logits_;
+};
+
+// an owning copy of one evaluation, kept in the evaluation cache
+class AlphaZeroNetworkEvaluation {
+public:
+    AlphaZeroNetworkEvaluation(const AlphaZeroNetworkOutput& output)
+        : value_(output.value_),
+          policy_(output.policy_, output.policy_ + output.policy_size_),
+          policy_logits_(output.policy_logits_, output.policy_logits_ + output.policy_size_) {}
+
+    inline AlphaZeroNetworkOutput getOutput() const { return {value_, static_cast<int>(policy_.size()), policy_.data(), policy_logits_.data()}; }
+
     float value_;
     std::vector<float> policy_;
     std::vector<float> policy_logits_;
+};
+
+typedef EvaluationCache<AlphaZeroNetworkEvaluation> AlphaZeroEvaluationCache;
 
-    AlphaZeroNetworkOutput(int policy_size)
+class AlphaZeroNetworkOutputBatch : public NetworkOutputBatch {
+public:
+    AlphaZeroNetworkOutputBatch(int batch_size, int policy_size, const torch::Tensor& policy, const torch::Tensor& policy_logits, std::vector<float>&& values)
+        : NetworkOutputBatch(batch_size),
+          policy_size_(policy_size),
+          policy_(policy.contiguous()),
+          policy_logits_(policy_logits.contiguous()),
+          values_(std::move(values)) {}
+
+    inline AlphaZeroNetworkOutput getOutput(int index) const
     {
-        value_ = 0.0f;
-        policy_.resize(policy_size, 0.0f);
-        policy_logits_.resize(policy_size, 0.0f);
+        assert(index >= 0 && index < batch_size_);
+        return {values_[index], policy_size_, policy_.data_ptr<float>() + index * policy_size_, policy_logits_.data_ptr<float>() + index * policy_size_};
     }
+
+protected:
+    int policy_size_;
+    torch::Tensor policy_;
+    torch::Tensor policy_logits_;
+    std::vector<float> values_;
 };
 
 class AlphaZeroNetwork : public Network {
 public:
-    AlphaZeroNetwork()
+    AlphaZeroNetwork(int reserved_batch_size)
+        : reserved_batch_size_(reserved_batch_size)
     {
         clear();
     }
@@ -36,6 +71,10 @@ public:
         assert(batch_size_ == 0); // should avoid loading model when batch size is not 0
         Network::loadModel(nn_file_name, gpu_id);
         clear();
+
+        // preallocate the input batch in pinned memory so that it can be copied to GPU asynchronously
+        tensor_input_ = torch::empty({reserved_batch_size_, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth()},
+                                     torch::TensorOptions().dtype(torch::kFloat32).pinned_memory(gpu_id != -1));
     }
 
     std::string toString() const override
@@ -45,79 +84,69 @@ public:
         return oss.str();
     }
 
-    int pushBack(std::vector<float> features)
+    int pushBack(const std::vector<float>& features)
     {
         assert(static_cast<int>(features.size()) == getNumInputChannels() * getInputChannelHeight() * getInputChannelWidth());
-        assert(batch_size_ < kReserved_batch_size);
 
-        int index;
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            index = batch_size_++;
-            tensor_input_.resize(batch_size_);
-        }
-        tensor_input_[index] = torch::from_blob(features.data(), {1, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth()}).clone();
+        int index = reserveBatchIndex();
+        std::copy(features.begin(), features.end(), getInputData(index));
+        return index;
+    }
+
+    // reserve a row of the input batch; the caller writes the features into getInputData(index) before forward()
+    inline int reserveBatchIndex()
+    {
+        int index = batch_size_++;
+        assert(index < reserved_batch_size_); // reserved_batch_size_ is the maximum number of rows between two forwards
         return index;
     }
+    inline float* getInputData(int index) { return tensor_input_.data_ptr<float>() + index * getNumInputChannels() * getInputChannelHeight() * getInputChannelWidth(); }
 
-    std::vector<std::shared_ptr<NetworkOutput>> forward()
+    std::shared_ptr<NetworkOutputBatch> forward()
     {
-        assert(batch_size_ > 0);
-        auto forward_result = network_.forward(std::vector<torch::jit::IValue>{torch::cat(tensor_input_).to(getDevice())}).toGenericDict();
+        const int batch_size = batch_size_;
+        assert(batch_size > 0);
+        auto forward_result = network_.forward(std::vector<torch::jit::IValue>{tensor_input_.narrow(0, 0, batch_size).to(getDevice(), /* non_blocking */ true)}).toGenericDict();
 
         auto policy_output = forward_result.at("policy").toTensor().to(at::kCPU);
         auto policy_logits_output = forward_result.at("policy_logit").toTensor().to(at::kCPU);
         auto value_output = forward_result.at("value").toTensor().to(at::kCPU);
-        assert(policy_output.numel() == batch_size_ * getActionSize());
-        assert(policy_logits_output.numel() == batch_size_ * getActionSize());
-        assert(value_output.numel() == batch_size_ * getDiscreteValueSize());
-
-        const int policy_size = getActionSize();
-        std::vector<std::shared_ptr<NetworkOutput>> network_outputs;
-        for (int i = 0; i < batch_size_; ++i) {
-            network_outputs.emplace_back(std::make_shared<AlphaZeroNetworkOutput>(policy_size));
-            auto alphazero_network_output = std::static_pointer_cast<AlphaZeroNetworkOutput>(network_outputs.back());
-
-            // policy & policy logits
-            std::copy(policy_output.data_ptr<float>() + i * policy_size,
-                      policy_output.data_ptr<float>() + (i + 1) * policy_size,
-                      alphazero_network_output->policy_.begin());
-            std::copy(policy_logits_output.data_ptr<float>() + i * policy_size,
-                      policy_logits_output.data_ptr<float>() + (i + 1) * policy_size,
-                      alphazero_network_output->policy_logits_.begin());
-
-            // value
+        assert(policy_output.numel() == batch_size * getActionSize());
+        assert(policy_logits_output.numel() == batch_size * getActionSize());
+        assert(value_output.numel() == batch_size * getDiscreteValueSize());
+
+        std::vector<float> values(batch_size);
+        const float* value_data = value_output.data_ptr<float>();
+        for (int i = 0; i < batch_size; ++i) {
             if (getDiscreteValueSize() == 1) {
-                alphazero_network_output->value_ = value_output[i].item<float>();
+                values[i] = value_data[i];
             } else {
                 int start_value = -getDiscreteValueSize() / 2;
-                alphazero_network_output->value_ = std::accumulate(value_output.data_ptr<float>() + i * getDiscreteValueSize(),
-                                                                   value_output.data_ptr<float>() + (i + 1) * getDiscreteValueSize(),
-                                                                   0.0f,
-                                                                   [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
-                alphazero_network_output->value_ = utils::invertValue(alphazero_network_output->value_);
+                values[i] = std::accumulate(value_data + i * getDiscreteValueSize(),
+                                            value_data + (i + 1) * getDiscreteValueSize(),
+                                            0.0f,
+                                            [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
+                values[i] = utils::invertValue(values[i]);
             }
         }
 
+        // policy and policy logits stay in the output tensors; actors read their rows through AlphaZeroNetworkOutput
+        std::shared_ptr<NetworkOutputBatch> network_output_batch = std::make_shared<AlphaZeroNetworkOutputBatch>(batch_size, getActionSize(), policy_output, policy_logits_output, std::move(values));
         clear();
-        return network_outputs;
+        return network_output_batch;
     }
 
     inline int getBatchSize() const { return batch_size_; }
+    inline void setEvaluationCache(const std::shared_ptr<AlphaZeroEvaluationCache>& evaluation_cache) { evaluation_cache_ = evaluation_cache; }
+    inline const std::shared_ptr<AlphaZeroEvaluationCache>& getEvaluationCache() const { return evaluation_cache_; }
 
 protected:
-    inline void clear()
-    {
-        batch_size_ = 0;
-        tensor_input_.clear();
-        tensor_input_.reserve(kReserved_batch_size);
-    }
-
-    int batch_size_;
-    std::mutex mutex_;
-    std::vector<torch::Tensor> tensor_input_;
+    inline void clear() { batch_size_ = 0; }
 
-    const int kReserved_batch_size = 4096;
+    std::atomic<int> batch_size_;
+    torch::Tensor tensor_input_;
+    std::shared_ptr<AlphaZeroEvaluationCache> evaluation_cache_;
+    int reserved_batch_size_;
 };
 
 } // namespace minizero::network
@@ -8,7 +8,8 @@
 
 namespace minizero::network {
 
-inline std::shared_ptr<Network> createNetwork(const std::string& nn_file_name, const int gpu_id)
+// reserved_batch_size is the maximum number of rows pushed between two forwards, which sizes the preallocated input batch
+inline std::shared_ptr<Network> createNetwork(const std::string& nn_file_name, const int gpu_id, const int reserved_batch_size)
 {
     // TODO: how to speed up?
     Network base_network;
@@ -16,10 +17,10 @@ inline std::shared_ptr<Network> createNetwork(const std::string& nn_file_name, c
 
     std::shared_ptr<Network> network;
     if (base_network.getNetworkTypeName() == "alphazero") {
-        network = std::make_shared<AlphaZeroNetwork>();
+        network = std::make_shared<AlphaZeroNetwork>(reserved_batch_size);
         std::dynamic_pointer_cast<AlphaZeroNetwork>(network)->loadModel(nn_file_name, gpu_id);
     } else if (base_network.getNetworkTypeName() == "muzero" || base_network.getNetworkTypeName() == "muzero_atari") {
-        network = std::make_shared<MuZeroNetwork>();
+        network = std::make_shared<MuZeroNetwork>(reserved_batch_size);
         std::dynamic_pointer_cast<MuZeroNetwork>(network)->loadModel(nn_file_name, gpu_id);
     } else {
         // should not be here
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace minizero::network {
+
+// thread-safe, size-bounded LRU cache; entries are spread over independently locked shards to reduce contention
+template <class Data>
+class EvaluationCache {
+public:
+    EvaluationCache(int size = 0, int num_shards = 64)
+        : generation_(0),
+          shard_size_(size > 0 ? std::max(1, size / num_shards) : 0),
+          shards_(size > 0 ? num_shards : 0) {}
+
+    // drop all entries; data evaluated before clearing (older generation) is no longer inserted
+    void clear()
+    {
+        ++generation_;
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            shard.entries_.clear();
+            shard.index_.clear();
+        }
+    }
+
+    inline bool isEnabled() const { return !shards_.empty(); }
+    inline int getGeneration() const { return generation_; }
+
+    std::shared_ptr<const Data> lookup(uint64_t key)
+    {
+        if (!isEnabled() || key == 0) { return nullptr; }
+        Shard& shard = getShard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        auto it = shard.index_.find(key);
+        if (it == shard.index_.end()) { return nullptr; }
+        shard.entries_.splice(shard.entries_.begin(), shard.entries_, it->second);
+        return it->second->second;
+    }
+
+    void insert(uint64_t key, int generation, const std::shared_ptr<const Data>& data)
+    {
+        if (!isEnabled() || key == 0 || generation != generation_) { return; }
+        Shard& shard = getShard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        if (shard.index_.count(key)) { return; }
+        shard.entries_.emplace_front(key, data);
+        shard.index_[key] = shard.entries_.begin();
+        if (static_cast<int>(shard.entries_.size()) > shard_size_) {
+            shard.index_.erase(shard.entries_.back().first);
+            shard.entries_.pop_back();
+        }
+    }
+
+private:
+    typedef std::list<std::pair<uint64_t, std::shared_ptr<const Data>>> EntryList;
+
+    class Shard {
+    public:
+        std::mutex mutex_;
+        EntryList entries_;
+        std::unordered_map<uint64_t, typename EntryList::iterator> index_;
+    };
+
+    inline Shard& getShard(uint64_t key) { return shards_[((key >> 32) ^ key) % shards_.size()]; }
+
+    std::atomic<int> generation_;
+    int shard_size_;
+    std::vector<Shard> shards_;
+};
+
+} // namespace minizero::network
@@ -3,54 +3,81 @@
 #include "network.h"
 #include "utils.h"
 #include <algorithm>
+#include <atomic>
 #include <memory>
-#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
 
 namespace minizero::network {
 
-class MuZeroNetworkOutput : public NetworkOutput {
+class MuZeroNetworkOutput {
 public:
     float value_;
     float reward_;
-    std::vector<float> policy_;
-    std::vector<float> policy_logits_;
-    std::vector<float> hidden_state_;
+    int policy_size_;
+    int hidden_state_size_;
+    const float* policy_;
+    const float* policy_logits_;
+    const float* hidden_state_;
+};
 
-    MuZeroNetworkOutput(int policy_size, int hidden_state_size)
+class MuZeroNetworkOutputBatch : public NetworkOutputBatch {
+public:
+    MuZeroNetworkOutputBatch(int batch_size, int policy_size, int hidden_state_size, const torch::Tensor& policy, const torch::Tensor& policy_logits, const torch::Tensor& hidden_state, std::vector<float>&& values, std::vector<float>&& rewards)
+        : NetworkOutputBatch(batch_size),
+          policy_size_(policy_size),
+          hidden_state_size_(hidden_state_size),
+          policy_(policy.contiguous()),
+          policy_logits_(policy_logits.contiguous()),
+          hidden_state_(hidden_state.contiguous()),
+          values_(std::move(values)),
+          rewards_(std::move(rewards)) {}
+
+    inline MuZeroNetworkOutput getOutput(int index) const
     {
-        value_ = 0.0f;
-        reward_ = 0.0f;
-        policy_.resize(policy_size, 0.0f);
-        policy_logits_.resize(policy_size, 0.0f);
-        hidden_state_.resize(hidden_state_size, 0.0f);
+        assert(index >= 0 && index < batch_size_);
+        return {values_[index], rewards_[index], policy_size_, hidden_state_size_,
+                policy_.data_ptr<float>() + index * policy_size_,
+                policy_logits_.data_ptr<float>() + index * policy_size_,
+                hidden_state_.data_ptr<float>() + index * hidden_state_size_};
     }
+
+protected:
+    int policy_size_;
+    int hidden_state_size_;
+    torch::Tensor policy_;
+    torch::Tensor policy_logits_;
+    torch::Tensor hidden_state_;
+    std::vector<float> values_;
+    std::vector<float> rewards_;
 };
 
 class MuZeroNetwork : public Network {
 public:
-    MuZeroNetwork()
+    MuZeroNetwork(int reserved_batch_size)
+        : reserved_batch_size_(reserved_batch_size)
     {
         num_action_feature_channels_ = -1;
-        initial_input_batch_size_ = recurrent_input_batch_size_ = 0;
-        initial_tensor_input_.clear();
-        initial_tensor_input_.reserve(kReserved_batch_size);
-        recurrent_tensor_feature_input_.clear();
-        recurrent_tensor_feature_input_.reserve(kReserved_batch_size);
-        recurrent_tensor_action_input_.clear();
-        recurrent_tensor_action_input_.reserve(kReserved_batch_size);
+        clearInitialBatch();
+        clearRecurrentBatch();
     }
 
     void loadModel(const std::string& nn_file_name, const int gpu_id) override
     {
+        assert(initial_input_batch_size_ == 0 && recurrent_input_batch_size_ == 0); // should avoid loading model when batch size is not 0
         Network::loadModel(nn_file_name, gpu_id);
 
         std::vector<torch::jit::IValue> dummy;
         num_action_feature_channels_ = network_.get_method("get_num_action_feature_channels")(dummy).toInt();
-        initial_input_batch_size_ = 0;
-        recurrent_input_batch_size_ = 0;
+        clearInitialBatch();
+        clearRecurrentBatch();
+
+        // preallocate the input batches in pinned memory; each worker reserves its own rows with an atomic counter
+        auto options = torch::TensorOptions().dtype(torch::kFloat32).pinned_memory(gpu_id != -1);
+        initial_tensor_input_ = torch::empty({reserved_batch_size_, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth()}, options);
+        recurrent_tensor_feature_input_ = torch::empty({reserved_batch_size_, getNumHiddenChannels(), getHiddenChannelHeight(), getHiddenChannelWidth()}, options);
+        recurrent_tensor_action_input_ = torch::empty({reserved_batch_size_, getNumActionFeatureChannels(), getHiddenChannelHeight(), getHiddenChannelWidth()}, options);
     }
 
     std::string toString() const override
@@ -61,58 +88,61 @@ public:
         return oss.str();
     }
 
-    int pushBackInitialData(std::vector<float> features)
+    int pushBackInitialData(const std::vector<float>& features)
     {
         assert(static_cast<int>(features.size()) == getNumInputChannels() * getInputChannelHeight() * getInputChannelWidth());
 
-        int index;
-        {
-            std::lock_guard<std::mutex> lock(initial_mutex_);
-            index = initial_input_batch_size_++;
-            initial_tensor_input_.resize(initial_input_batch_size_);
-        }
-        initial_tensor_input_[index] = torch::from_blob(features.data(), {1, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth()}).clone();
+        int index = reserveInitialBatchIndex();
+        std::copy(features.begin(), features.end(), getInitialInputData(index));
         return index;
     }
 
-    int pushBackRecurrentData(std::vector<float> features, std::vector<float> actions)
+    int pushBackRecurrentData(const std::vector<float>& features, const std::vector<float>& actions)
     {
         assert(static_cast<int>(features.size()) == getNumHiddenChannels() * getHiddenChannelHeight() * getHiddenChannelWidth());
         assert(static_cast<int>(actions.size()) == getNumActionFeatureChannels() * getHiddenChannelHeight() * getHiddenChannelWidth());
 
-        int index;
-        {
-            std::lock_guard<std::mutex> lock(recurrent_mutex_);
-            index = recurrent_input_batch_size_++;
-            recurrent_tensor_feature_input_.resize(recurrent_input_batch_size_);
-            recurrent_tensor_action_input_.resize(recurrent_input_batch_size_);
-        }
-        recurrent_tensor_feature_input_[index] = torch::from_blob(features.data(), {1, getNumHiddenChannels(), getHiddenChannelHeight(), getHiddenChannelWidth()}).clone();
-        recurrent_tensor_action_input_[index] = torch::from_blob(actions.data(), {1, getNumActionFeatureChannels(), getHiddenChannelHeight(), getHiddenChannelWidth()}).clone();
+        int index = reserveRecurrentBatchIndex();
+        std::copy(features.begin(), features.end(), getRecurrentFeatureInputData(index));
+        std::copy(actions.begin(), actions.end(), getRecurrentActionInputData(index));
         return index;
     }
 
-    inline std::vector<std::shared_ptr<NetworkOutput>> initialInference()
+    // reserve a row of the input batch; the caller writes the inputs into the row before the inference
+    inline int reserveInitialBatchIndex()
+    {
+        int index = initial_input_batch_size_++;
+        assert(index < reserved_batch_size_); // reserved_batch_size_ is the maximum number of rows between two inferences
+        return index;
+    }
+    inline int reserveRecurrentBatchIndex()
     {
-        assert(initial_input_batch_size_ > 0);
-        auto outputs = forward("initial_inference", {torch::cat(initial_tensor_input_).to(getDevice())}, initial_input_batch_size_);
-        initial_tensor_input_.clear();
-        initial_tensor_input_.reserve(kReserved_batch_size);
-        initial_input_batch_size_ = 0;
+        int index = recurrent_input_batch_size_++;
+        assert(index < reserved_batch_size_);
+        return index;
+    }
+    inline float* getInitialInputData(int index) { return initial_tensor_input_.data_ptr<float>() + index * getNumInputChannels() * getInputChannelHeight() * getInputChannelWidth(); }
+    inline float* getRecurrentFeatureInputData(int index) { return recurrent_tensor_feature_input_.data_ptr<float>() + index * getNumHiddenChannels() * getHiddenChannelHeight() * getHiddenChannelWidth(); }
+    inline float* getRecurrentActionInputData(int index) { return recurrent_tensor_action_input_.data_ptr<float>() + index * getNumActionFeatureChannels() * getHiddenChannelHeight() * getHiddenChannelWidth(); }
+
+    inline std::shared_ptr<NetworkOutputBatch> initialInference()
+    {
+        const int batch_size = initial_input_batch_size_;
+        assert(batch_size > 0);
+        auto outputs = forward("initial_inference", {initial_tensor_input_.narrow(0, 0, batch_size).to(getDevice(), /* non_blocking */ true)}, batch_size);
+        clearInitialBatch();
         return outputs;
     }
 
-    inline std::vector<std::shared_ptr<NetworkOutput>> recurrentInference()
+    inline std::shared_ptr<NetworkOutputBatch> recurrentInference()
     {
-        assert(recurrent_input_batch_size_ > 0);
+        const int batch_size = recurrent_input_batch_size_;
+        assert(batch_size > 0);
         auto outputs = forward("recurrent_inference",
-                               {{torch::cat(recurrent_tensor_feature_input_).to(getDevice())}, {torch::cat(recurrent_tensor_action_input_).to(getDevice())}},
-                               recurrent_input_batch_size_);
-        recurrent_tensor_feature_input_.clear();
-        recurrent_tensor_feature_input_.reserve(kReserved_batch_size);
-        recurrent_tensor_action_input_.clear();
-        recurrent_tensor_action_input_.reserve(kReserved_batch_size);
-        recurrent_input_batch_size_ = 0;
+                               {{recurrent_tensor_feature_input_.narrow(0, 0, batch_size).to(getDevice(), /* non_blocking */ true)},
+                                {recurrent_tensor_action_input_.narrow(0, 0, batch_size).to(getDevice(), /* non_blocking */ true)}},
+                               batch_size);
+        clearRecurrentBatch();
         return outputs;
     }
 
@@ -121,7 +151,7 @@ public:
     inline int getRecurrentInputBatchSize() const { return recurrent_input_batch_size_; }
 
 protected:
-    std::vector<std::shared_ptr<NetworkOutput>> forward(const std::string& method, const std::vector<torch::jit::IValue>& inputs, int batch_size)
+    std::shared_ptr<NetworkOutputBatch> forward(const std::string& method, const std::vector<torch::jit::IValue>& inputs, int batch_size)
     {
         assert(network_.find_method(method));
 
@@ -137,56 +167,44 @@ protected:
         assert(!forward_result.contains("reward") || (forward_result.contains("reward") && reward_output.numel() == batch_size * getDiscreteValueSize()));
         assert(hidden_state_output.numel() == batch_size * getNumHiddenChannels() * getHiddenChannelHeight() * getHiddenChannelWidth());
 
-        const int policy_size = getActionSize();
-        const int hidden_state_size = getNumHiddenChannels() * getHiddenChannelHeight() * getHiddenChannelWidth();
-        std::vector<std::shared_ptr<NetworkOutput>> network_outputs;
+        std::vector<float> values(batch_size, 0.0f), rewards(batch_size, 0.0f);
+        const float* value_data = value_output.data_ptr<float>();
         for (int i = 0; i < batch_size; ++i) {
-            network_outputs.emplace_back(std::make_shared<MuZeroNetworkOutput>(policy_size, hidden_state_size));
-            auto muzero_network_output = std::static_pointer_cast<MuZeroNetworkOutput>(network_outputs.back());
-
-            std::copy(policy_output.data_ptr<float>() + i * policy_size,
-                      policy_output.data_ptr<float>() + (i + 1) * policy_size,
-                      muzero_network_output->policy_.begin());
-            std::copy(policy_logits_output.data_ptr<float>() + i * policy_size,
-                      policy_logits_output.data_ptr<float>() + (i + 1) * policy_size,
-                      muzero_network_output->policy_logits_.begin());
-            std::copy(hidden_state_output.data_ptr<float>() + i * hidden_state_size,
-                      hidden_state_output.data_ptr<float>() + (i + 1) * hidden_state_size,
-                      muzero_network_output->hidden_state_.begin());
-
             if (getNetworkTypeName() == "muzero_atari") {
                 int start_value = -getDiscreteValueSize() / 2;
-                muzero_network_output->value_ = std::accumulate(value_output.data_ptr<float>() + i * getDiscreteValueSize(),
-                                                                value_output.data_ptr<float>() + (i + 1) * getDiscreteValueSize(),
-                                                                0.0f,
-                                                                [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
-                muzero_network_output->value_ = utils::invertValue(muzero_network_output->value_);
+                values[i] = std::accumulate(value_data + i * getDiscreteValueSize(),
+                                            value_data + (i + 1) * getDiscreteValueSize(),
+                                            0.0f,
+                                            [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
+                values[i] = utils::invertValue(values[i]);
                 if (forward_result.contains("reward")) {
                     start_value = -getDiscreteValueSize() / 2;
-                    muzero_network_output->reward_ = std::accumulate(reward_output.data_ptr<float>() + i * getDiscreteValueSize(),
-                                                                     reward_output.data_ptr<float>() + (i + 1) * getDiscreteValueSize(),
-                                                                     0.0f,
-                                                                     [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
-                    muzero_network_output->reward_ = utils::invertValue(muzero_network_output->reward_);
+                    rewards[i] = std::accumulate(reward_output.data_ptr<float>() + i * getDiscreteValueSize(),
+                                                 reward_output.data_ptr<float>() + (i + 1) * getDiscreteValueSize(),
+                                                 0.0f,
+                                                 [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
+                    rewards[i] = utils::invertValue(rewards[i]);
                 }
             } else {
-                muzero_network_output->value_ = value_output[i].item<float>();
+                values[i] = value_data[i];
             }
         }
 
-        return network_outputs;
+        // policy, policy logits, and hidden states stay in the output tensors; actors read their rows through MuZeroNetworkOutput
+        const int hidden_state_size = getNumHiddenChannels() * getHiddenChannelHeight() * getHiddenChannelWidth();
+        return std::make_shared<MuZeroNetworkOutputBatch>(batch_size, getActionSize(), hidden_state_size, policy_output, policy_logits_output, hidden_state_output, std::move(values), std::move(rewards));
     }
 
+    inline void clearInitialBatch() { initial_input_batch_size_ = 0; }
+    inline void clearRecurrentBatch() { recurrent_input_batch_size_ = 0; }
+
     int num_action_feature_channels_;
-    int initial_input_batch_size_;
-    int recurrent_input_batch_size_;
-    std::mutex initial_mutex_;
-    std::mutex recurrent_mutex_;
-    std::vector<torch::Tensor> initial_tensor_input_;
-    std::vector<torch::Tensor> recurrent_tensor_feature_input_;
-    std::vector<torch::Tensor> recurrent_tensor_action_input_;
-
-    const int kReserved_batch_size = 4096;
+    std::atomic<int> initial_input_batch_size_;
+    std::atomic<int> recurrent_input_batch_size_;
+    torch::Tensor initial_tensor_input_;
+    torch::Tensor recurrent_tensor_feature_input_;
+    torch::Tensor recurrent_tensor_action_input_;
+    int reserved_batch_size_;
 };
 
 } // namespace minizero::network
@@ -7,9 +7,16 @@
 
 namespace minizero::network {
 
-class NetworkOutput {
+class NetworkOutputBatch {
 public:
-    virtual ~NetworkOutput() = default;
+    NetworkOutputBatch(int batch_size)
+        : batch_size_(batch_size) {}
+    virtual ~NetworkOutputBatch() = default;
+
+    inline int getBatchSize() const { return batch_size_; }
+
+protected:
+    int batch_size_;
 };
 
 class Network {
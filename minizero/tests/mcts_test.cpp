@@ -0,0 +1,115 @@
+#include "mcts.h"
+#include <functional>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace minizero::actor {
+
+namespace {
+
+void expandNode(MCTS& mcts, MCTSNode* node, int num_children, int first_action_id = 0)
+{
+    std::vector<MCTS::ActionCandidate> action_candidates;
+    for (int i = 0; i < num_children; ++i) { action_candidates.emplace_back(Action(first_action_id + i, env::Player::kPlayer1), 1.0f / num_children, 0.0f); }
+    mcts.expand(node, action_candidates);
+}
+
+// (action id, count, hidden state) of all nodes in the subtree, in preorder
+std::string getSubtreeString(const MCTS& mcts, const MCTSNode* node)
+{
+    std::ostringstream oss;
+    oss << "(" << node->getAction().getActionID() << " " << node->getCount();
+    if (node->getHiddenStateDataIndex() != -1) { oss << " h" << mcts.getTreeHiddenStateData().getData(node->getHiddenStateDataIndex()).hidden_state_[0]; }
+    for (int i = 0; i < node->getNumChildren(); ++i) { oss << getSubtreeString(mcts, node->getChild(i)); }
+    oss << ")";
+    return oss.str();
+}
+
+bool isInFirstChunk(const MCTS& mcts, const MCTSNode* node, int chunk_size)
+{
+    // nodes of different chunks belong to different arrays, so compare their addresses instead of subtracting them
+    const MCTSNode* first_node = mcts.getRootNode();
+    return std::less_equal<const MCTSNode*>()(first_node, node) && std::less<const MCTSNode*>()(node, first_node + chunk_size);
+}
+
+} // namespace
+
+TEST(MCTSTest, ReuseSubtreeKeepsOnlyTheNewRootSubtree)
+{
+    MCTS mcts(100);
+    mcts.reset();
+    expandNode(mcts, mcts.getRootNode(), 3);
+    MCTSNode* root = mcts.getRootNode();
+    expandNode(mcts, root->getChild(0), 4, 10);
+    expandNode(mcts, root->getChild(1), 2, 20);
+    expandNode(mcts, root->getChild(1)->getChild(1), 3, 30);
+    mcts.backup({root, root->getChild(0), root->getChild(0)->getChild(2)}, 1.0f);
+    mcts.backup({root, root->getChild(1), root->getChild(1)->getChild(0)}, 0.5f);
+    mcts.backup({root, root->getChild(1), root->getChild(1)->getChild(1)}, -0.5f);
+    root->getChild(0)->setHiddenStateDataIndex(mcts.getTreeHiddenStateData().store(HiddenStateData({0.1f})));
+    root->getChild(1)->getChild(1)->setHiddenStateDataIndex(mcts.getTreeHiddenStateData().store(HiddenStateData({0.2f})));
+    ASSERT_EQ(mcts.getNumUsedNodes(), 1u + 3 + 4 + 2 + 3);
+
+    MCTSNode* new_root = root->getChild(1);
+    std::string subtree = getSubtreeString(mcts, new_root);
+    mcts.reuseSubtree(new_root);
+
+    EXPECT_EQ(getSubtreeString(mcts, mcts.getRootNode()), subtree);
+    EXPECT_EQ(mcts.getNumUsedNodes(), 1u + 2 + 3);
+    EXPECT_EQ(mcts.getTreeHiddenStateData().size(), 1);
+    EXPECT_EQ(mcts.getNumReusedSimulation(), 2);
+    EXPECT_EQ(mcts.getNumSimulation(), 0);
+
+    // the compacted tree can be searched and expanded as usual
+    expandNode(mcts, mcts.getRootNode()->getChild(0), 2, 40);
+    EXPECT_EQ(mcts.getNumUsedNodes(), 1u + 2 + 3 + 2);
+    mcts.backup({mcts.getRootNode(), mcts.getRootNode()->getChild(0)}, 1.0f);
+    EXPECT_EQ(mcts.getNumSimulation(), 1);
+}
+
+TEST(MCTSTest, ReuseSubtreeCompactsLaterChunksToTheFront)
+{
+    // 8192 nodes per chunk
+    MCTS mcts(30000);
+    mcts.reset();
+    expandNode(mcts, mcts.getRootNode(), 2);
+    MCTSNode* root = mcts.getRootNode();
+    expandNode(mcts, root->getChild(0), 8000, 100);
+    expandNode(mcts, root->getChild(1), 200, 10000); // does not fit in the rest of the first chunk
+    for (int i = 0; i < 50; ++i) {
+        expandNode(mcts, root->getChild(1)->getChild(i), 10, 20000);
+        mcts.backup({root, root->getChild(1), root->getChild(1)->getChild(i), root->getChild(1)->getChild(i)->getChild(i % 10)}, 0.1f * (i % 7));
+    }
+    ASSERT_EQ(mcts.getNumAllocatedNodes(), 2u * 8192);
+    ASSERT_FALSE(isInFirstChunk(mcts, root->getChild(1)->getChild(0), 8192));
+
+    MCTSNode* new_root = root->getChild(1);
+    std::string subtree = getSubtreeString(mcts, new_root);
+    mcts.reuseSubtree(new_root);
+
+    EXPECT_EQ(getSubtreeString(mcts, mcts.getRootNode()), subtree);
+    EXPECT_EQ(mcts.getNumUsedNodes(), 1u + 200 + 50 * 10);
+    EXPECT_EQ(mcts.getNumReusedSimulation(), 50);
+    EXPECT_TRUE(isInFirstChunk(mcts, mcts.getRootNode()->getChild(0), 8192));
+    EXPECT_TRUE(isInFirstChunk(mcts, mcts.getRootNode()->getChild(49)->getChild(9), 8192));
+
+    // the chunks are kept, so growing the tree again does not allocate more nodes
+    expandNode(mcts, mcts.getRootNode()->getChild(60), 8000, 30000);
+    EXPECT_EQ(mcts.getNumAllocatedNodes(), 2u * 8192);
+    mcts.reset();
+    EXPECT_EQ(mcts.getNumUsedNodes(), 1u);
+    EXPECT_EQ(mcts.getNumAllocatedNodes(), 2u * 8192);
+}
+
+TEST(MCTSTest, SmallTreeOnlyAllocatesItsSize)
+{
+    MCTS mcts(100);
+    mcts.reset();
+    expandNode(mcts, mcts.getRootNode(), 100);
+    EXPECT_EQ(mcts.getNumAllocatedNodes(), 101u);
+    EXPECT_EQ(mcts.getNumUsedNodes(), 101u);
+}
+
+} // namespace minizero::actor
@@ -0,0 +1,75 @@
+#include "rotation.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace minizero::utils {
+
+namespace {
+
+const int kNumRotations = static_cast<int>(Rotation::kRotateSize);
+
+} // namespace
+
+TEST(RotationTest, TableMatchesPositionByRotating)
+{
+    for (int board_size : {1, 2, 3, 8, 9, 15, 19, 32}) {
+        for (int r = 0; r < kNumRotations; ++r) {
+            Rotation rotation = static_cast<Rotation>(r);
+            const std::vector<int>& positions = getRotatePositions(rotation, board_size);
+            ASSERT_EQ(static_cast<int>(positions.size()), board_size * board_size + 1);
+            for (int pos = 0; pos <= board_size * board_size; ++pos) {
+                EXPECT_EQ(positions[pos], getPositionByRotating(rotation, pos, board_size)) << getRotationString(rotation) << ", board_size = " << board_size << ", pos = " << pos;
+            }
+        }
+    }
+}
+
+TEST(RotationTest, Rotation90On3x3Board)
+{
+    EXPECT_EQ(getRotatePositions(Rotation::kRotation90, 3), std::vector<int>({6, 3, 0, 7, 4, 1, 8, 5, 2, 9}));
+}
+
+TEST(RotationTest, TableIsPermutationAndKeepsPass)
+{
+    for (int board_size : {4, 7, 19}) {
+        const int pass = board_size * board_size;
+        for (int r = 0; r < kNumRotations; ++r) {
+            std::vector<int> positions = getRotatePositions(static_cast<Rotation>(r), board_size);
+            EXPECT_EQ(positions[pass], pass);
+            std::sort(positions.begin(), positions.end());
+            for (int pos = 0; pos <= pass; ++pos) { EXPECT_EQ(positions[pos], pos); }
+        }
+    }
+}
+
+TEST(RotationTest, ReversedRotationRestoresPosition)
+{
+    for (int board_size : {5, 6, 19}) {
+        for (int r = 0; r < kNumRotations; ++r) {
+            const std::vector<int>& positions = getRotatePositions(static_cast<Rotation>(r), board_size);
+            const std::vector<int>& reversed_positions = getRotatePositions(reversed_rotation[r], board_size);
+            for (int pos = 0; pos <= board_size * board_size; ++pos) { EXPECT_EQ(reversed_positions[positions[pos]], pos); }
+        }
+    }
+}
+
+TEST(RotationTest, ConcurrentFirstUseBuildsTheSameTable)
+{
+    // the table of this board size is not used by the other tests, so all threads race to build it
+    const int board_size = 13;
+    std::vector<const std::vector<int>*> tables(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < tables.size(); ++i) {
+        threads.emplace_back([&tables, i, board_size]() { tables[i] = &getRotatePositions(Rotation::kHorizontalRotation90, board_size); });
+    }
+    for (auto& thread : threads) { thread.join(); }
+    for (const auto* table : tables) {
+        EXPECT_EQ(table, tables[0]);
+        ASSERT_EQ(static_cast<int>(table->size()), board_size * board_size + 1);
+    }
+    for (int pos = 0; pos <= board_size * board_size; ++pos) { EXPECT_EQ((*tables[0])[pos], getPositionByRotating(Rotation::kHorizontalRotation90, pos, board_size)); }
+}
+
+} // namespace minizero::utils
@@ -0,0 +1,66 @@
+#include "sum_tree.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace minizero::utils {
+
+TEST(SumTreeTest, BuildFromWeights)
+{
+    SumTree sum_tree(std::vector<float>{1.0f, 2.0f, 3.0f, 4.0f, 5.0f});
+    EXPECT_EQ(sum_tree.size(), 5);
+    EXPECT_DOUBLE_EQ(sum_tree.getTotal(), 15.0);
+    for (int i = 0; i < 5; ++i) { EXPECT_DOUBLE_EQ(sum_tree.get(i), i + 1.0); }
+}
+
+TEST(SumTreeTest, SampleByPrefixWeight)
+{
+    SumTree sum_tree(std::vector<float>{1.0f, 2.0f, 3.0f, 4.0f, 5.0f});
+    EXPECT_EQ(sum_tree.sample(0.0), 0);
+    EXPECT_EQ(sum_tree.sample(0.999), 0);
+    EXPECT_EQ(sum_tree.sample(1.0), 1);
+    EXPECT_EQ(sum_tree.sample(2.999), 1);
+    EXPECT_EQ(sum_tree.sample(3.0), 2);
+    EXPECT_EQ(sum_tree.sample(6.0), 3);
+    EXPECT_EQ(sum_tree.sample(10.0), 4);
+    EXPECT_EQ(sum_tree.sample(14.999), 4);
+}
+
+TEST(SumTreeTest, SetUpdatesTotalAndSampling)
+{
+    SumTree sum_tree(3);
+    EXPECT_DOUBLE_EQ(sum_tree.getTotal(), 0.0);
+    sum_tree.set(0, 1.0);
+    sum_tree.set(2, 3.0);
+    EXPECT_DOUBLE_EQ(sum_tree.getTotal(), 4.0);
+    EXPECT_EQ(sum_tree.sample(0.5), 0);
+    EXPECT_EQ(sum_tree.sample(1.5), 2);
+
+    sum_tree.set(2, 0.5);
+    sum_tree.set(1, 2.0);
+    EXPECT_DOUBLE_EQ(sum_tree.getTotal(), 3.5);
+    EXPECT_EQ(sum_tree.sample(1.5), 1);
+    EXPECT_EQ(sum_tree.sample(3.2), 2);
+}
+
+TEST(SumTreeTest, ZeroWeightIsNeverSampled)
+{
+    SumTree sum_tree(std::vector<float>{0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f});
+    for (double value = 0.0; value < sum_tree.getTotal(); value += 0.01) {
+        int index = sum_tree.sample(value);
+        EXPECT_GT(sum_tree.get(index), 0.0) << "value = " << value;
+    }
+    // values rounded up to the total still fall in the last non-zero weight
+    EXPECT_EQ(sum_tree.sample(sum_tree.getTotal()), 3);
+}
+
+TEST(SumTreeTest, SampleIsProportionalToWeight)
+{
+    std::vector<float> weights{0.5f, 1.5f, 0.0f, 3.0f, 1.0f, 2.0f, 0.25f};
+    SumTree sum_tree(weights);
+    const int num_samples = 100000;
+    std::vector<int> counts(weights.size(), 0);
+    for (int i = 0; i < num_samples; ++i) { ++counts[sum_tree.sample((i + 0.5) / num_samples * sum_tree.getTotal())]; }
+    for (size_t i = 0; i < weights.size(); ++i) { EXPECT_NEAR(counts[i], weights[i] / sum_tree.getTotal() * num_samples, 1.0); }
+}
+
+} // namespace minizero::utils
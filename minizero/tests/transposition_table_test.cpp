@@ -0,0 +1,60 @@
+#include "transposition_table.h"
+#include <gtest/gtest.h>
+
+namespace minizero::actor {
+
+TEST(TranspositionTableTest, StoreAndLookup)
+{
+    TranspositionTable<int> table(8);
+    EXPECT_TRUE(table.isEnabled());
+    EXPECT_EQ(table.lookup(3), nullptr);
+
+    table.store(3, 30);
+    table.store(4, 40);
+    ASSERT_NE(table.lookup(3), nullptr);
+    EXPECT_EQ(*table.lookup(3), 30);
+    ASSERT_NE(table.lookup(4), nullptr);
+    EXPECT_EQ(*table.lookup(4), 40);
+    EXPECT_EQ(table.lookup(5), nullptr);
+
+    table.store(3, 31);
+    EXPECT_EQ(*table.lookup(3), 31);
+}
+
+TEST(TranspositionTableTest, NewEntryReplacesTheOneInItsSlot)
+{
+    TranspositionTable<int> table(8);
+    table.store(3, 30);
+    table.store(11, 110);
+    EXPECT_EQ(table.lookup(3), nullptr);
+    ASSERT_NE(table.lookup(11), nullptr);
+    EXPECT_EQ(*table.lookup(11), 110);
+}
+
+TEST(TranspositionTableTest, ZeroKeyIsIgnored)
+{
+    TranspositionTable<int> table(8);
+    table.store(0, 1);
+    EXPECT_EQ(table.lookup(0), nullptr);
+    EXPECT_EQ(table.lookup(8), nullptr);
+}
+
+TEST(TranspositionTableTest, Clear)
+{
+    TranspositionTable<int> table(8);
+    table.store(3, 30);
+    table.store(12, 120);
+    table.clear();
+    EXPECT_EQ(table.lookup(3), nullptr);
+    EXPECT_EQ(table.lookup(12), nullptr);
+}
+
+TEST(TranspositionTableTest, EmptyTableIsDisabled)
+{
+    TranspositionTable<int> table;
+    EXPECT_FALSE(table.isEnabled());
+    table.store(3, 30);
+    EXPECT_EQ(table.lookup(3), nullptr);
+}
+
+} // namespace minizero::actor
@@ -0,0 +1,95 @@
+#include "utils.h"
+#include <gtest/gtest.h>
+#include <string>
+
+namespace minizero::utils {
+
+namespace {
+
+std::string getAllBytes()
+{
+    std::string s;
+    for (int i = 0; i < 256; ++i) { s += static_cast<char>(i); }
+    return s;
+}
+
+} // namespace
+
+TEST(UtilsTest, Base64KnownValues)
+{
+    // test vectors from RFC 4648
+    EXPECT_EQ(binaryToBase64String(""), "");
+    EXPECT_EQ(binaryToBase64String("f"), "Zg==");
+    EXPECT_EQ(binaryToBase64String("fo"), "Zm8=");
+    EXPECT_EQ(binaryToBase64String("foo"), "Zm9v");
+    EXPECT_EQ(binaryToBase64String("foob"), "Zm9vYg==");
+    EXPECT_EQ(binaryToBase64String("fooba"), "Zm9vYmE=");
+    EXPECT_EQ(binaryToBase64String("foobar"), "Zm9vYmFy");
+    EXPECT_EQ(base64ToBinaryString("Zm9vYmE="), "fooba");
+    EXPECT_EQ(base64ToBinaryString(""), "");
+}
+
+TEST(UtilsTest, Base64AndHexRoundTrip)
+{
+    const std::string bytes = getAllBytes();
+    for (size_t length = 0; length <= bytes.size(); length += 37) {
+        const std::string s = bytes.substr(bytes.size() - length);
+        EXPECT_EQ(base64ToBinaryString(binaryToBase64String(s)), s);
+        EXPECT_EQ(hexToBinaryString(binaryToHexString(s)), s);
+    }
+    EXPECT_EQ(binaryToHexString("\x01\xab\xff"), "01abff");
+}
+
+TEST(UtilsTest, FrameDeltaRoundTrip)
+{
+    const std::string frames = "\x10\x20\x30\x10\x21\x30\xff\x00\x30\x01\x02";
+    const std::string delta = encodeFrameDelta(frames, 3);
+    EXPECT_EQ(delta.substr(0, 6), std::string("\x10\x20\x30\x00\x01\x00", 6));
+    EXPECT_EQ(decodeFrameDelta(delta, 3), frames);
+
+    const std::string bytes = getAllBytes();
+    for (int frame_size : {1, 7, 256, 1000}) { EXPECT_EQ(decodeFrameDelta(encodeFrameDelta(bytes, frame_size), frame_size), bytes); }
+    EXPECT_EQ(encodeFrameDelta(bytes, 0), bytes);
+    EXPECT_EQ(encodeFrameDelta("", 3), "");
+}
+
+TEST(UtilsTest, CompressStringRoundTrip)
+{
+    std::string frames;
+    for (int i = 0; i < 50; ++i) { frames += std::string(64, 'a' + i % 3) + getAllBytes(); }
+    for (int frame_size : {0, 64 + 256}) {
+        const std::string compressed = compressString(frames, frame_size);
+        EXPECT_EQ(compressed.rfind("z" + std::to_string(frame_size) + ":", 0), 0u);
+        EXPECT_EQ(decompressString(compressed), frames);
+    }
+    EXPECT_EQ(decompressString(compressString("x")), "x");
+}
+
+TEST(UtilsTest, CompressStringKeepsEmptyString)
+{
+    EXPECT_EQ(compressString(""), "");
+    EXPECT_EQ(compressString("", 3), "");
+    EXPECT_EQ(decompressString(""), "");
+    EXPECT_EQ(compressToBinaryString(""), "");
+    EXPECT_EQ(decompressBinaryString(""), "");
+}
+
+TEST(UtilsTest, DecompressLegacyHexString)
+{
+    const std::string s = "legacy observation string";
+    EXPECT_EQ(decompressString(binaryToHexString(compressToBinaryString(s))), s);
+}
+
+TEST(UtilsTest, EncodeMessageFrame)
+{
+    EXPECT_EQ(encodeMessageFrame("a\nbc\n", false), "Frame 5 0\na\nbc\n");
+
+    const std::string messages = "SelfPlay game 1\nSelfPlay game 2\n";
+    const std::string frame = encodeMessageFrame(messages, true);
+    const size_t header_end = frame.find('\n');
+    const std::string payload = frame.substr(header_end + 1);
+    EXPECT_EQ(frame.substr(0, header_end), "Frame " + std::to_string(payload.size()) + " 1");
+    EXPECT_EQ(decompressBinaryString(payload), messages);
+}
+
+} // namespace minizero::utils
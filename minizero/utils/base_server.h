@@ -1,10 +1,12 @@
 #pragma once
 
+#include "utils.h"
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/thread.hpp>
 #include <queue>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -12,8 +14,10 @@ namespace minizero::utils {
 
 class ConnectionHandler : public boost::enable_shared_from_this<ConnectionHandler> {
 public:
-    ConnectionHandler(boost::asio::io_service& io_service)
+    ConnectionHandler(boost::asio::io_service& io_service, size_t max_frame_size)
         : is_closed_(false),
+          is_reading_frame_(false),
+          max_frame_size_(max_frame_size),
           socket_(io_service),
           strand_(io_service)
     {
@@ -48,6 +52,7 @@ public:
     }
 
     inline bool isClosed() const { return is_closed_; }
+    inline bool isReadingFrame() const { return is_reading_frame_; }
     inline boost::asio::ip::tcp::socket& getSocket() { return socket_; }
 
     virtual void handleReceivedMessage(const std::string& message) = 0;
@@ -89,11 +94,61 @@ private:
         std::istream is(&read_buffer_);
         std::string line;
         std::getline(is, line);
+        if (line.compare(0, 6, "Frame ") == 0) { return startReadFrame(line); }
         handleReceivedMessage(line);
         startRead();
     }
 
+    void startReadFrame(const std::string& header)
+    {
+        // format: Frame payload_size is_compressed, see utils::encodeMessageFrame()
+        std::istringstream iss(header.substr(6));
+        size_t payload_size = 0;
+        bool is_compressed = false;
+        // the payload size comes from the peer, so a corrupted or hostile header must not decide how much memory is allocated
+        if (!(iss >> payload_size >> is_compressed) || payload_size > max_frame_size_) {
+            close();
+            return;
+        }
+
+        // part of the payload may already be in the buffer
+        size_t bytes_to_read = (payload_size > read_buffer_.size() ? payload_size - read_buffer_.size() : 0);
+        boost::asio::async_read(socket_,
+                                read_buffer_,
+                                boost::asio::transfer_exactly(bytes_to_read),
+                                boost::bind(&ConnectionHandler::handleReadFrame,
+                                            shared_from_this(),
+                                            boost::asio::placeholders::error,
+                                            payload_size,
+                                            is_compressed));
+    }
+
+    void handleReadFrame(const boost::system::error_code& error, size_t payload_size, bool is_compressed)
+    {
+        if (error) {
+            close();
+            return;
+        }
+
+        std::string payload(payload_size, '\0');
+        std::istream is(&read_buffer_);
+        is.read(&payload[0], payload_size);
+        if (is_compressed) { payload = decompressBinaryString(payload); }
+
+        // the messages in a frame are complete, so the handler does not need to check them for broken lines
+        is_reading_frame_ = true;
+        for (size_t begin = 0, end; begin < payload.size(); begin = end + 1) {
+            end = payload.find('\n', begin);
+            if (end == std::string::npos) { end = payload.size(); }
+            if (end > begin) { handleReceivedMessage(payload.substr(begin, end - begin)); }
+        }
+        is_reading_frame_ = false;
+        startRead();
+    }
+
     bool is_closed_;
+    bool is_reading_frame_;
+    size_t max_frame_size_;
     std::queue<std::string> message_queue_;
     boost::asio::ip::tcp::socket socket_;
     boost::asio::io_service::strand strand_;
@@ -0,0 +1,24 @@
+#include "rotation.h"
+#include <mutex>
+
+namespace minizero::utils {
+
+const int kMaxRotateBoardSize = 32;
+std::vector<std::vector<int>> rotate_positions[kMaxRotateBoardSize + 1];
+std::once_flag rotate_positions_flags[kMaxRotateBoardSize + 1];
+
+const std::vector<int>& getRotatePositions(Rotation rotation, int board_size)
+{
+    // the tables of a board size are built once on first use
+    assert(board_size >= 1 && board_size <= kMaxRotateBoardSize);
+    std::call_once(rotate_positions_flags[board_size], [board_size]() {
+        std::vector<std::vector<int>>& positions = rotate_positions[board_size];
+        positions.resize(static_cast<int>(Rotation::kRotateSize));
+        for (int r = 0; r < static_cast<int>(Rotation::kRotateSize); ++r) {
+            for (int pos = 0; pos <= board_size * board_size; ++pos) { positions[r].push_back(getPositionByRotating(static_cast<Rotation>(r), pos, board_size)); }
+        }
+    });
+    return rotate_positions[board_size][static_cast<int>(rotation)];
+}
+
+} // namespace minizero::utils
@@ -92,4 +92,7 @@ inline int getPositionByRotating(Rotation rotation, int original_pos, int board_
     return new_pos;
 }
 
+// rotated position of every position by table lookup, including the pass position (board_size * board_size)
+const std::vector<int>& getRotatePositions(Rotation rotation, int board_size);
+
 } // namespace minizero::utils
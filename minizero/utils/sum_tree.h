@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace minizero::utils {
+
+// binary tree over non-negative weights: O(log N) update and proportional sampling, O(1) total weight
+// internal nodes are recomputed from their children on each update, so the sums do not accumulate floating-point error
+class SumTree {
+public:
+    SumTree(int size = 0) { resize(size); }
+    SumTree(const std::vector<float>& weights)
+    {
+        resize(weights.size());
+        std::copy(weights.begin(), weights.end(), nodes_.begin() + capacity_);
+        for (int i = capacity_ - 1; i >= 1; --i) { nodes_[i] = nodes_[2 * i] + nodes_[2 * i + 1]; }
+    }
+
+    inline void resize(int size)
+    {
+        size_ = size;
+        capacity_ = 1;
+        while (capacity_ < size_) { capacity_ <<= 1; }
+        nodes_.assign(2 * capacity_, 0.0);
+    }
+
+    inline void set(int index, double weight)
+    {
+        assert(index >= 0 && index < size_ && weight >= 0.0);
+        index += capacity_;
+        nodes_[index] = weight;
+        for (index >>= 1; index >= 1; index >>= 1) { nodes_[index] = nodes_[2 * index] + nodes_[2 * index + 1]; }
+    }
+
+    // return the index whose prefix weight range contains value, where 0 <= value < getTotal()
+    inline int sample(double value) const
+    {
+        int index = 1;
+        while (index < capacity_) {
+            if (value < nodes_[2 * index] || nodes_[2 * index + 1] <= 0.0) {
+                index = 2 * index;
+            } else {
+                value -= nodes_[2 * index];
+                index = 2 * index + 1;
+            }
+        }
+        return std::min(index - capacity_, size_ - 1);
+    }
+
+    inline int size() const { return size_; }
+    inline double get(int index) const { return nodes_[capacity_ + index]; }
+    inline double getTotal() const { return nodes_[1]; }
+
+private:
+    int size_;
+    int capacity_;
+    std::vector<double> nodes_;
+};
+
+} // namespace minizero::utils
@@ -4,6 +4,7 @@
 #include <boost/iostreams/copy.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filtering_streambuf.hpp>
+#include <cassert>
 #include <cmath>
 #include <iomanip>
 #include <numeric>
@@ -49,11 +50,18 @@ inline std::string compressToBinaryString(const std::string& s)
 inline std::string binaryToHexString(const std::string& s)
 {
     // encode binary string to hex string
-    std::ostringstream oss;
+    const char* digits = "0123456789abcdef";
+    std::string hex_string(2 * s.size(), '0');
     for (size_t i = 0; i < s.size(); ++i) {
-        oss << std::setfill('0') << std::setw(2) << std::hex << static_cast<int>(static_cast<unsigned char>(s[i]));
+        hex_string[2 * i] = digits[static_cast<unsigned char>(s[i]) >> 4];
+        hex_string[2 * i + 1] = digits[static_cast<unsigned char>(s[i]) & 0xF];
     }
-    return oss.str();
+    return hex_string;
+}
+
+inline int hexDigitToInt(char c)
+{
+    return (c >= '0' && c <= '9' ? c - '0' : (c >= 'a' && c <= 'f' ? c - 'a' + 10 : c - 'A' + 10));
 }
 
 inline std::string hexToBinaryString(const std::string& s)
@@ -61,9 +69,50 @@ inline std::string hexToBinaryString(const std::string& s)
     assert(s.size() % 2 == 0);
 
     // decode hex string to binary string
-    std::string decompressed_string;
-    for (size_t i = 0; i < s.size(); i += 2) { decompressed_string += static_cast<unsigned char>(std::stoi(s.substr(i, 2), 0, 16)); }
-    return decompressed_string;
+    std::string binary_string(s.size() / 2, '\0');
+    for (size_t i = 0; i < binary_string.size(); ++i) { binary_string[i] = static_cast<char>(hexDigitToInt(s[2 * i]) << 4 | hexDigitToInt(s[2 * i + 1])); }
+    return binary_string;
+}
+
+inline std::string binaryToBase64String(const std::string& s)
+{
+    // encode binary string to base64 string, 3 bytes to 4 characters
+    const char* digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string base64_string;
+    base64_string.reserve((s.size() + 2) / 3 * 4);
+    for (size_t i = 0; i < s.size(); i += 3) {
+        unsigned int bits = static_cast<unsigned char>(s[i]) << 16;
+        if (i + 1 < s.size()) { bits |= static_cast<unsigned char>(s[i + 1]) << 8; }
+        if (i + 2 < s.size()) { bits |= static_cast<unsigned char>(s[i + 2]); }
+        base64_string += digits[(bits >> 18) & 0x3F];
+        base64_string += digits[(bits >> 12) & 0x3F];
+        base64_string += (i + 1 < s.size() ? digits[(bits >> 6) & 0x3F] : '=');
+        base64_string += (i + 2 < s.size() ? digits[bits & 0x3F] : '=');
+    }
+    return base64_string;
+}
+
+inline std::string base64ToBinaryString(const std::string& s)
+{
+    assert(s.size() % 4 == 0);
+
+    // decode base64 string to binary string
+    static const std::vector<int> values = [] {
+        const std::string digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::vector<int> values(256, 0);
+        for (size_t i = 0; i < digits.size(); ++i) { values[static_cast<unsigned char>(digits[i])] = i; }
+        return values;
+    }();
+    std::string binary_string;
+    binary_string.reserve(s.size() / 4 * 3);
+    for (size_t i = 0; i < s.size(); i += 4) {
+        unsigned int bits = 0;
+        for (size_t j = i; j < i + 4; ++j) { bits = (bits << 6) | values[static_cast<unsigned char>(s[j])]; }
+        binary_string += static_cast<char>((bits >> 16) & 0xFF);
+        if (s[i + 2] != '=') { binary_string += static_cast<char>((bits >> 8) & 0xFF); }
+        if (s[i + 3] != '=') { binary_string += static_cast<char>(bits & 0xFF); }
+    }
+    return binary_string;
 }
 
 inline std::string decompressBinaryString(const std::string& s)
@@ -80,14 +129,49 @@ inline std::string decompressBinaryString(const std::string& s)
     return decompressed.str();
 }
 
-inline std::string compressString(const std::string& s)
+inline std::string encodeFrameDelta(const std::string& s, int frame_size)
 {
-    return binaryToHexString(compressToBinaryString(s));
+    // replace each byte by its difference from the same byte of the previous frame, so that static pixels become zeros
+    if (frame_size <= 0) { return s; }
+    std::string delta = s;
+    for (size_t i = frame_size; i < s.size(); ++i) { delta[i] = static_cast<char>(static_cast<unsigned char>(s[i]) - static_cast<unsigned char>(s[i - frame_size])); }
+    return delta;
+}
+
+inline std::string decodeFrameDelta(const std::string& s, int frame_size)
+{
+    if (frame_size <= 0) { return s; }
+    std::string frames = s;
+    for (size_t i = frame_size; i < frames.size(); ++i) { frames[i] = static_cast<char>(static_cast<unsigned char>(frames[i]) + static_cast<unsigned char>(frames[i - frame_size])); }
+    return frames;
+}
+
+// compressed strings are "z<frame_size>:" followed by the base64 of the gzip compressed frame deltas (see encodeFrameDelta)
+// strings without the prefix are the hex-encoded gzip written by older versions, and are still decompressed
+// an empty string is kept empty in both directions
+inline std::string compressString(const std::string& s, int frame_size = 0)
+{
+    if (s.empty()) { return s; }
+    return "z" + std::to_string(frame_size) + ":" + binaryToBase64String(compressToBinaryString(encodeFrameDelta(s, frame_size)));
 }
 
 inline std::string decompressString(const std::string& s)
 {
-    return decompressBinaryString(hexToBinaryString(s));
+    if (s.empty()) { return s; }
+    if (s[0] != 'z') { return decompressBinaryString(hexToBinaryString(s)); }
+
+    size_t colon = s.find(':');
+    assert(colon != std::string::npos);
+    int frame_size = std::stoi(s.substr(1, colon - 1));
+    return decodeFrameDelta(decompressBinaryString(base64ToBinaryString(s.substr(colon + 1))), frame_size);
+}
+
+// a frame is a header line "Frame <payload_size> <is_compressed>" followed by exactly payload_size bytes of payload
+// the payload, after decompressing, is one or more messages each ending with '\n'
+inline std::string encodeMessageFrame(const std::string& messages, bool compress)
+{
+    const std::string payload = (compress ? compressToBinaryString(messages) : messages);
+    return "Frame " + std::to_string(payload.size()) + " " + (compress ? "1" : "0") + "\n" + payload;
 }
 
 inline float transformValue(float value)
@@ -36,19 +36,22 @@ void ZeroLogger::addLog(const std::string& log_str, std::fstream& log_file)
     std::cerr << TimeSystem::getTimeString("[Y/m/d_H:i:s.f] ") << log_str << std::endl;
 }
 
-ZeroSelfPlayData::ZeroSelfPlayData(std::string input_data)
+ZeroSelfPlayData::ZeroSelfPlayData(const std::string& input_data)
 {
     // format: Selfplay is_terminal data_length game_length return game_record
-    input_data = input_data.substr(input_data.find(" ") + 1); // remove Selfplay
-    is_terminal_ = (input_data.substr(0, input_data.find(" ")) == "true");
-    input_data = input_data.substr(input_data.find(" ") + 1); // remove is_terminal
-    data_length_ = std::stoi(input_data.substr(0, input_data.find(" ")));
-    input_data = input_data.substr(input_data.find(" ") + 1); // remove data_length
-    game_length_ = std::stoi(input_data.substr(0, input_data.find(" ")));
-    input_data = input_data.substr(input_data.find(" ") + 1); // remove game_length
-    return_ = std::stof(input_data.substr(0, input_data.find(" ")));
-    input_data = input_data.substr(input_data.find(" ") + 1); // remove return
-    game_record_ = input_data.substr(0, input_data.find(" "));
+    // only the short header fields are copied, the game record is copied once
+    size_t begin = input_data.find(" ") + 1; // skip Selfplay
+    auto nextField = [&input_data, &begin]() {
+        size_t end = std::min(input_data.find(" ", begin), input_data.size());
+        std::string field = input_data.substr(begin, end - begin);
+        begin = end + 1;
+        return field;
+    };
+    is_terminal_ = (nextField() == "true");
+    data_length_ = std::stoi(nextField());
+    game_length_ = std::stoi(nextField());
+    return_ = std::stof(nextField());
+    game_record_ = nextField();
 }
 
 bool ZeroWorkerSharedData::getSelfPlayData(ZeroSelfPlayData& sp_data)
@@ -76,10 +79,12 @@ int ZeroWorkerSharedData::getModelIetration()
 
 void ZeroWorkerHandler::handleReceivedMessage(const std::string& message)
 {
+    // self-play games are large, so only the command is read before parsing the game
+    const std::string command = message.substr(0, message.find(" "));
     std::vector<std::string> args;
-    boost::split(args, message, boost::is_any_of(" "), boost::token_compress_on);
+    if (command != "SelfPlay") { boost::split(args, message, boost::is_any_of(" "), boost::token_compress_on); }
 
-    if (args[0] == "Info") {
+    if (command == "Info") {
         name_ = args[1];
         type_ = args[2];
         boost::lock_guard<boost::mutex> lock(shared_data_.worker_mutex_);
@@ -107,8 +112,9 @@ void ZeroWorkerHandler::handleReceivedMessage(const std::string& message)
             ConnectionHandler::close();
         }
         is_idle_ = true;
-    } else if (args[0] == "SelfPlay") {
-        if (message.find("SelfPlay", message.find("SelfPlay", 0) + 1) != std::string::npos || message.back() != '#') {
+    } else if (command == "SelfPlay") {
+        // games in a frame are always complete, while games in text lines may be broken by other outputs of the worker
+        if (message.back() != '#' || (!isReadingFrame() && message.find("SelfPlay", command.size()) != std::string::npos)) {
             shared_data_.logger_.addWorkerLog("[Worker Error] Receive broken self-play games");
             return;
         }
@@ -121,11 +127,11 @@ void ZeroWorkerHandler::handleReceivedMessage(const std::string& message)
         if (shared_data_.sp_data_queue_.size() % std::max(1, static_cast<int>(config::zero_num_games_per_iteration * 0.25)) == 0) {
             shared_data_.logger_.addTrainingLog("[SelfPlay Game Buffer] " + std::to_string(shared_data_.sp_data_queue_.size()) + " games");
         }
-    } else if (args[0] == "Optimization_Done") {
+    } else if (command == "Optimization_Done") {
         boost::lock_guard<boost::mutex> lock(shared_data_.mutex_);
         shared_data_.model_iteration_ = stoi(args[1]);
         shared_data_.is_optimization_phase_ = false;
-    } else if (args[0] == "Log") {
+    } else if (command == "Log") {
         shared_data_.logger_.addWorkerLog("[Log] " + getName() + " " + getType() + ": " + message.substr(message.find(" ") + 1));
     } else {
         std::string error_message = message;
@@ -38,7 +38,7 @@ public:
     std::string game_record_;
 
     ZeroSelfPlayData() {}
-    ZeroSelfPlayData(std::string input_data);
+    ZeroSelfPlayData(const std::string& input_data);
 };
 
 class ZeroWorkerSharedData {
@@ -66,7 +66,7 @@ public:
 class ZeroWorkerHandler : public utils::ConnectionHandler {
 public:
     ZeroWorkerHandler(boost::asio::io_service& io_service, ZeroWorkerSharedData& shared_data)
-        : ConnectionHandler(io_service),
+        : ConnectionHandler(io_service, config::zero_server_max_frame_size),
           is_idle_(false),
           shared_data_(shared_data)
     {